@@ -0,0 +1,142 @@
+"""Screen-resolution downsampling for plotting long sensor sessions.
+
+lttb() picks the points of Largest-Triangle-Three-Buckets, which keeps
+peaks, steps and slopes visible with a few thousand points.
+minmax_envelope() reduces each bucket to its min/max for shaded bands.
+ZoomDownsampler re-runs both on the visible x-range whenever the axes are
+zoomed or panned, so detail appears as you zoom in.
+"""
+
+import numpy as np
+
+DEFAULT_POINTS_PER_PIXEL = 2
+ENVELOPE_ALPHA = 0.25
+
+
+def lttb(x, y, n_out):
+    """Return the indices of the n_out points LTTB keeps from (x, y).
+
+    x must be sorted and free of NaN. The first and last point are always kept.
+    """
+    x = np.asarray(x, dtype=np.float64)
+    y = np.asarray(y, dtype=np.float64)
+    n = len(x)
+    if n_out >= n or n_out < 3:
+        return np.arange(n)
+
+    # Bucket edges over the inner points, first and last point are fixed
+    edges = np.linspace(1, n - 1, n_out - 1).astype(np.int64)
+    selected = np.empty(n_out, dtype=np.int64)
+    selected[0] = 0
+    selected[-1] = n - 1
+    a = 0
+    for i in range(n_out - 2):
+        start, end = edges[i], edges[i + 1]
+        # Average of the next bucket, or the last point for the final bucket
+        if i + 2 < len(edges):
+            next_start, next_end = edges[i + 1], edges[i + 2]
+            avg_x = x[next_start:next_end].mean()
+            avg_y = y[next_start:next_end].mean()
+        else:
+            avg_x, avg_y = x[-1], y[-1]
+        # Twice the triangle area between the last pick, a candidate and the average
+        area = np.abs(
+            (x[a] - avg_x) * (y[start:end] - y[a])
+            - (x[a] - x[start:end]) * (avg_y - y[a])
+        )
+        a = start + int(np.argmax(area))
+        selected[i + 1] = a
+    return selected
+
+
+def minmax_envelope(x, y, n_buckets):
+    """Reduce (x, y) to n_buckets of (bucket centre, min, max) for fill_between."""
+    x = np.asarray(x, dtype=np.float64)
+    y = np.asarray(y, dtype=np.float64)
+    n = len(x)
+    if n == 0:
+        return x, y, y
+    n_buckets = max(min(n_buckets, n), 1)
+    starts = np.linspace(0, n, n_buckets, endpoint=False).astype(np.int64)
+    centres = np.add.reduceat(x, starts) / np.diff(np.append(starts, n))
+    return centres, np.minimum.reduceat(y, starts), np.maximum.reduceat(y, starts)
+
+
+def envelope_vertices(x, y, n_buckets):
+    """Closed polygon around the min/max envelope, as fill_between draws it."""
+    centres, lower, upper = minmax_envelope(x, y, n_buckets)
+    return np.column_stack(
+        (np.concatenate((centres, centres[::-1])), np.concatenate((upper, lower[::-1])))
+    )
+
+
+def visible_range(x, x_min, x_max):
+    """Index range of the points inside [x_min, x_max] plus one neighbour each side."""
+    start = max(int(np.searchsorted(x, x_min, side="left")) - 1, 0)
+    end = min(int(np.searchsorted(x, x_max, side="right")) + 1, len(x))
+    return start, end
+
+
+class ZoomDownsampler:
+    """Plot long series through LTTB and recompute them on every zoom or pan.
+
+    Each line gets a shaded min/max band with one bucket per pixel behind
+    it, so short spikes between the LTTB picks stay visible.
+    """
+
+    def __init__(self, points_per_pixel=DEFAULT_POINTS_PER_PIXEL):
+        self.points_per_pixel = points_per_pixel
+        self.lines = []  # (line, envelope band or None, full x, full y)
+        self.connected_axes = set()
+
+    def target_points(self, ax):
+        width_px = ax.get_window_extent().width
+        return max(int(width_px * self.points_per_pixel), 3)
+
+    @staticmethod
+    def envelope_buckets(ax):
+        return max(int(ax.get_window_extent().width), 1)
+
+    def plot(self, ax, x, y, envelope=True, **kwargs):
+        """Like ax.plot(x, y), keeping the full series for later zoom levels."""
+        x = np.asarray(x, dtype=np.float64)
+        y = np.asarray(y, dtype=np.float64)
+        keep = ~np.isnan(x) & ~np.isnan(y)
+        x, y = x[keep], y[keep]
+        order = np.argsort(x, kind="stable")
+        x, y = x[order], y[order]
+
+        selected = lttb(x, y, self.target_points(ax))
+        (line,) = ax.plot(x[selected], y[selected], **kwargs)
+        band = None
+        if envelope:
+            centres, lower, upper = minmax_envelope(x, y, self.envelope_buckets(ax))
+            band = ax.fill_between(
+                centres,
+                lower,
+                upper,
+                color=line.get_color(),
+                alpha=ENVELOPE_ALPHA,
+                linewidth=0,
+                zorder=line.get_zorder() - 0.5,
+            )
+        self.lines.append((line, band, x, y))
+        if ax not in self.connected_axes:
+            ax.callbacks.connect("xlim_changed", self.on_xlim_changed)
+            self.connected_axes.add(ax)
+        return line
+
+    def on_xlim_changed(self, ax):
+        x_min, x_max = ax.get_xlim()
+        shared = ax.get_shared_x_axes()
+        for line, band, x, y in self.lines:
+            if line.axes is not ax and not shared.joined(ax, line.axes):
+                continue
+            start, end = visible_range(x, x_min, x_max)
+            selected = start + lttb(x[start:end], y[start:end], self.target_points(line.axes))
+            line.set_data(x[selected], y[selected])
+            if band is not None:
+                # New vertices in place, a new fill_between would re-trigger autoscaling
+                band.set_verts(
+                    [envelope_vertices(x[start:end], y[start:end], self.envelope_buckets(line.axes))]
+                )
@@ -0,0 +1,129 @@
+"""Compare the firmware build variants of platformio.ini on size and speed.
+
+For every variant env, builds the firmware and reads RAM / flash usage from
+the PlatformIO size summary. With --port, each variant is also uploaded and
+the on-device benchmark ('b') is run, so the table pairs size with the
+per-sample hot-path timing in ns. Variants built without the 'b' command
+are size-only: they are not uploaded and show n/a for every timing.
+
+    python firmware_variants.py                  # sizes only
+    python firmware_variants.py --board m0 --port /dev/ttyACM0
+"""
+
+import argparse
+import re
+import subprocess
+import time
+from pathlib import Path
+
+import serial
+
+PLATFORMIO_DIR = Path(__file__).parent / "platformio"
+VARIANTS = {
+    "m0": (
+        "adafruit_sht4xtrinkey_m0",
+        "adafruit_sht4xtrinkey_m0_o2",
+        "adafruit_sht4xtrinkey_m0_o2_lto",
+        "adafruit_sht4xtrinkey_m0_headless",
+    ),
+    "rp2040": (
+        "trinkeyrp2040qt",
+        "trinkeyrp2040qt_o2",
+        "trinkeyrp2040qt_o2_lto",
+        "trinkeyrp2040qt_xip",
+        "trinkeyrp2040qt_headless",
+    ),
+}
+# Built with FEATURE_DIAGNOSTICS=0, so there is no 'b' to run
+SIZE_ONLY_VARIANTS = {
+    "adafruit_sht4xtrinkey_m0_headless",
+    "trinkeyrp2040qt_headless",
+}
+BAUD_RATE = 115200
+BENCH_COMMAND = b"b"
+BENCH_PREFIX = "# bench, "
+BENCH_DONE = "# bench done"
+BENCH_TIMEOUT = 10  # seconds
+BOOT_WAIT = 3  # seconds after upload before the port is opened
+
+# "RAM:   [=         ]   9.8% (used 3204 bytes from 32768 bytes)"
+SIZE_LINE = re.compile(r"^(RAM|Flash):.*\(used (\d+) bytes from (\d+) bytes\)", re.MULTILINE)
+
+
+def build(env, upload=False):
+    """Build (and optionally upload) one env, return {"RAM": (used, total), "Flash": ...}."""
+    command = ["pio", "run", "-e", env]
+    if upload:
+        command += ["-t", "upload"]
+    result = subprocess.run(
+        command, cwd=PLATFORMIO_DIR, capture_output=True, text=True, check=True
+    )
+    return {kind: (int(used), int(total)) for kind, used, total in SIZE_LINE.findall(result.stdout)}
+
+
+def run_benchmark(port):
+    """Send 'b' and collect {operation: ns per op} until the device is done."""
+    results = {}
+    with serial.Serial(port, BAUD_RATE, timeout=1) as ser:
+        ser.reset_input_buffer()
+        ser.write(BENCH_COMMAND)
+        deadline = time.time() + BENCH_TIMEOUT
+        while time.time() < deadline:
+            line = ser.readline().decode("utf-8", errors="replace").strip()
+            if line == BENCH_DONE:
+                break
+            if line.startswith(BENCH_PREFIX):
+                name, _, value = line[len(BENCH_PREFIX) :].partition(", ")
+                if value.isdigit():
+                    results[name] = int(value)
+    return results
+
+
+def format_size(size):
+    if size is None:
+        return "-"
+    used, total = size
+    return f"{used} ({100 * used / total:.1f}%)"
+
+
+def format_timing(bench, operation):
+    if bench is None:
+        return "n/a"  # Size-only variant
+    return str(bench.get(operation, "-"))
+
+
+def print_table(rows, operations):
+    header = ["env", "flash", "ram"] + [f"{op} (ns)" for op in operations]
+    table = [header] + [
+        [env, format_size(sizes.get("Flash")), format_size(sizes.get("RAM"))]
+        + [format_timing(bench, op) for op in operations]
+        for env, sizes, bench in rows
+    ]
+    widths = [max(len(row[i]) for row in table) for i in range(len(header))]
+    for row in table:
+        print("  ".join(cell.ljust(width) for cell, width in zip(row, widths)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--board", choices=sorted(VARIANTS), action="append")
+    parser.add_argument("--port", help="Serial port of the board, enables upload and benchmark")
+    args = parser.parse_args()
+
+    rows, operations = [], []
+    for board in args.board or sorted(VARIANTS):
+        for env in VARIANTS[board]:
+            print(f"Building {env}...")
+            benchmark = args.port is not None and env not in SIZE_ONLY_VARIANTS
+            sizes = build(env, upload=benchmark)
+            bench = None if env in SIZE_ONLY_VARIANTS else {}
+            if benchmark:
+                time.sleep(BOOT_WAIT)
+                bench = run_benchmark(args.port)
+                operations += [op for op in bench if op not in operations]
+            rows.append((env, sizes, bench))
+    print_table(rows, operations)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,43 @@
+/*
+ * Overlapping Allan deviation of raw SHT4x ticks in integer arithmetic
+ *
+ * Samples taken every tau0 are kept as running sums x[k] = y[0] + ... + y[k-1],
+ * so the deviation at tau = m * tau0 is
+ *   sigma^2 = sum_j (x[j+2m] - 2 x[j+m] + x[j])^2 / (2 m^2 (N - 2m + 1))
+ * for m = 1, 2, 4, ... while at least one second difference fits.
+ */
+
+#ifndef ALLAN_DEVIATION_H
+#define ALLAN_DEVIATION_H
+
+#include <Arduino.h>
+
+#define ALLAN_MAX_SAMPLES  512  // Per channel, 2 x 2 KB of running sums
+
+struct AllanBuffer {
+  uint16_t count;                            // Samples added
+  uint32_t tSums[ALLAN_MAX_SAMPLES + 1];     // Running sums, tSums[0] = 0
+  uint32_t rhSums[ALLAN_MAX_SAMPLES + 1];
+};
+
+/**
+ * Start a new series
+ */
+void allanReset(AllanBuffer *buffer);
+
+/**
+ * Append one sample, returns false once the buffer is full
+ */
+bool allanAdd(AllanBuffer *buffer, uint16_t tTicks, uint16_t rhTicks);
+
+/**
+ * Deviation at averaging factor m in 1/100 ticks, 0 if the series is too short
+ */
+uint32_t allanDeviationCenti(const uint32_t *sums, uint16_t count, uint16_t m);
+
+/**
+ * Print one comment line per octave: precision, tau (ms), T and RH deviation
+ */
+void allanPrint(Print &out, const AllanBuffer &buffer, uint8_t precision, uint32_t tau0Ms);
+
+#endif  // ALLAN_DEVIATION_H
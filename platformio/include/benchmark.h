@@ -0,0 +1,39 @@
+/*
+ * Hot-path micro-benchmarks, printed as "# bench, <operation>, <ns per op>"
+ * so build variants can be compared on the device itself
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <Arduino.h>
+
+typedef void (*BenchmarkOp)();
+
+/**
+ * Print sink that only counts bytes, so formatting is timed without USB
+ */
+class NullPrint : public Print {
+ public:
+  size_t write(uint8_t) override {
+    count++;
+    return 1;
+  }
+  size_t write(const uint8_t *, size_t size) override {
+    count += size;
+    return size;
+  }
+  uint32_t count = 0;
+};
+
+/**
+ * Run op iterations times and print the mean time per call
+ */
+void benchmarkRun(Print &out, const char *name, BenchmarkOp op, uint16_t iterations);
+
+/**
+ * Print a result measured by the caller
+ */
+void benchmarkPrintResult(Print &out, const char *name, uint32_t totalUs, uint16_t iterations);
+
+#endif  // BENCHMARK_H
@@ -0,0 +1,54 @@
+/*
+ * Compact binary sample frames
+ *
+ * Frames are interleaved with the normal newline-terminated text output:
+ *   0xA5 0x5A | type (u8) | length (u8) | payload (little-endian) | CRC-8
+ * The CRC covers type, length and payload and uses the same Sensirion
+ * polynomial as the SHT4x itself, so one routine checks both.
+ */
+
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <Arduino.h>
+
+// Host protocol version reported by the 'c' command, bumped whenever
+// commands, text lines or frame layouts change incompatibly
+#define PROTOCOL_VERSION   4
+
+#define FRAME_SYNC_0       0xA5
+#define FRAME_SYNC_1       0x5A
+#define FRAME_MAX_PAYLOAD  64
+
+// Frame types
+#define FRAME_TYPE_RAW_SOF 0x03  // serial (u32), timestamp (u32), T ticks (u16), RH ticks (u16),
+                                 // USB frame (u16), offset into frame in us (u16),
+                                 // conversion window in us (u16), sample sequence (u32)
+
+// Output formats selectable with the 'f' command
+enum OutputFormat : uint8_t {
+  FORMAT_CSV = 0,
+  FORMAT_BINARY = 1,
+};
+
+/**
+ * Sensirion CRC-8 (polynomial 0x31, init 0xFF)
+ */
+uint8_t crc8(const uint8_t *data, size_t len);
+
+/**
+ * Write one frame with sync marker, header and CRC
+ */
+void writeFrame(Print &out, uint8_t type, const uint8_t *payload, uint8_t len);
+
+/**
+ * Write a raw-tick sample frame with its USB start-of-frame stamp,
+ * conversion window and sequence number, conversion and alignment are
+ * left to the host
+ */
+void writeRawSampleFrame(Print &out, uint32_t serialNumber, uint32_t timestamp,
+                         uint16_t tTicks, uint16_t rhTicks,
+                         uint16_t sofFrame, uint16_t sofOffsetUs, uint16_t conversionUs,
+                         uint32_t sequence);
+
+#endif  // BINARY_PROTOCOL_H
@@ -0,0 +1,35 @@
+/*
+ * Boot-to-first-sample profiling
+ *
+ * Each startup phase records micros() since reset the first time it is
+ * reached. The profile is printed with the banner when a host connects.
+ */
+
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <Arduino.h>
+
+enum BootPhase : uint8_t {
+  BOOT_PIXEL,          // pixel.begin() done
+  BOOT_SENSOR,         // sht4xBegin() done
+  BOOT_SERIAL_NUMBER,  // sht4xReadSerial() done
+  BOOT_CONFIG,         // Configuration loaded
+  BOOT_SCHEDULER,      // Tasks running, setup() finished
+  BOOT_FIRST_SAMPLE,   // First sample queued
+  BOOT_USB_CONFIGURED, // Host enumerated and configured the device, polled every 2 ms
+  BOOT_PORT_OPEN,      // A host opened the serial port (DTR)
+  BOOT_PHASE_COUNT
+};
+
+/**
+ * Record the end of a phase, later calls for the same phase are ignored
+ */
+void bootMark(BootPhase phase);
+
+/**
+ * Print all phases as one comment line, "-" for phases not reached yet
+ */
+void bootPrintProfile(Print &out);
+
+#endif  // BOOT_PROFILE_H
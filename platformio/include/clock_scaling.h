@@ -0,0 +1,75 @@
+/*
+ * Dynamic system clock scaling (RP2040)
+ *
+ * Between bursts of work the firmware mostly polls the scheduler, waiting
+ * for conversions, the next sample period or a host command. While idle the
+ * system clock drops to the 48 MHz of the USB PLL, the system PLL is
+ * stopped and the core voltage lowered. Formatting output, driving the
+ * NeoPixel and the benchmark raise it back to the full clock first. USB
+ * keeps its own 48 MHz clock from the USB PLL throughout, and the timer
+ * behind millis()/micros() runs from the crystal, so neither USB nor
+ * timestamps notice the switches.
+ *
+ * The time spent at each level feeds a rough energy model, reported per
+ * sample with the task statistics.
+ *
+ * Only the cooperative RP2040 build scales; on the SAMD21 (CPU and USB share
+ * the 48 MHz DFLL) and with FreeRTOS (tasks on both cores) the calls compile
+ * to nothing.
+ */
+
+#ifndef CLOCK_SCALING_H
+#define CLOCK_SCALING_H
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_RP2040) && !defined(PIO_FRAMEWORK_ARDUINO_ENABLE_FREERTOS)
+#define CLOCK_SCALING 1
+#else
+#define CLOCK_SCALING 0
+#endif
+
+#if CLOCK_SCALING
+
+/**
+ * Take the current clock as the full clock, call once the bus is up
+ */
+void clockBegin();
+
+/**
+ * Drop to the idle clock and voltage, nothing while already idle
+ */
+void clockIdle();
+
+/**
+ * Back to the full clock before a burst of work
+ */
+void clockBurst();
+
+/**
+ * Restart the time and sample accounting, e.g. with a new measurement
+ */
+void clockResetStats();
+
+/**
+ * Count one sample for the energy-per-sample estimate
+ */
+void clockSampleDone();
+
+/**
+ * Print time per clock level and the energy estimate as a comment line
+ */
+void clockPrintStats(Print &out);
+
+#else
+
+inline void clockBegin() {}
+inline void clockIdle() {}
+inline void clockBurst() {}
+inline void clockResetStats() {}
+inline void clockSampleDone() {}
+inline void clockPrintStats(Print &) {}
+
+#endif  // CLOCK_SCALING
+
+#endif  // CLOCK_SCALING_H
@@ -0,0 +1,78 @@
+/*
+ * Stackless coroutines for the cooperative scheduler
+ *
+ * A sequence such as command -> wait -> poll ACK -> read is written as
+ * straight-line code between CO_BEGIN and CO_END. Each CO_AWAIT_* saves the
+ * resume point and returns to the scheduler, which acts as the executor and
+ * resumes the owning task when the timer expires or another task signals it.
+ *
+ * Locals do not survive a suspension, so every sequence keeps its state in a
+ * statically allocated frame struct next to its Coroutine member. No heap and
+ * no per-coroutine stack are used. Resume points are switch labels (Duff's
+ * device), so a CO_AWAIT must not be placed inside another switch statement.
+ */
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <Arduino.h>
+#include "scheduler.h"
+
+#define CO_NO_TIMEOUT 0xFFFFFFFFUL  // Suspended until signalled with schedulerWake()
+
+enum CoStatus : uint8_t { CO_WAITING, CO_DONE };
+
+struct Coroutine {
+  uint16_t line;    // Resume point, 0 = start
+  uint32_t waitMs;  // Requested delay before the next resume
+};
+
+#define CO_BEGIN(co) switch ((co).line) { case 0:
+
+#define CO_END(co) } (co).line = 0; return CO_DONE
+
+// Suspend for ms milliseconds
+#define CO_AWAIT_MS(co, ms)           \
+  do {                                \
+    (co).waitMs = (ms);               \
+    (co).line = __LINE__;             \
+    return CO_WAITING;                \
+    case __LINE__:;                   \
+  } while (0)
+
+// Suspend until another task wakes the owning task
+#define CO_AWAIT_SIGNAL(co) CO_AWAIT_MS(co, CO_NO_TIMEOUT)
+
+// Re-check cond every pollMs milliseconds
+#define CO_AWAIT_UNTIL(co, cond, pollMs) \
+  while (!(cond)) CO_AWAIT_MS(co, pollMs)
+
+// Leave the sequence early, the next resume starts from CO_BEGIN
+#define CO_EXIT(co)   \
+  do {                \
+    (co).line = 0;    \
+    return CO_DONE;   \
+  } while (0)
+
+inline void coroutineReset(Coroutine &co) {
+  co.line = 0;
+  co.waitMs = 0;
+}
+
+inline bool coroutineAwaitingSignal(const Coroutine &co) {
+  return co.line != 0 && co.waitMs == CO_NO_TIMEOUT;
+}
+
+/**
+ * Executor step: resume a sequence from its task and re-arm the task
+ * for the delay it asked for
+ */
+inline CoStatus coroutineStep(Coroutine &co, CoStatus (*sequence)(), uint8_t taskId) {
+  CoStatus status = sequence();
+  if (status == CO_WAITING && co.waitMs != CO_NO_TIMEOUT) {
+    schedulerWake(taskId, co.waitMs);
+  }
+  return status;
+}
+
+#endif  // COROUTINE_H
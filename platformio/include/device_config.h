@@ -0,0 +1,66 @@
+/*
+ * Persistent device configuration
+ *
+ * Stored in flash (FlashStorage on the SAMD21, emulated EEPROM on the
+ * RP2040) with a magic number, layout version and CRC. An invalid or
+ * missing record falls back to the defaults, which match the original
+ * host-driven behaviour: wait for 's', then sample on every 'u'.
+ */
+
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <Arduino.h>
+
+#define CONFIG_MAGIC    0x53485434UL  // "SHT4"
+#define CONFIG_VERSION  2
+
+enum Precision : uint8_t {
+  PRECISION_HIGH = 0,
+  PRECISION_MEDIUM = 1,
+  PRECISION_LOW = 2,
+};
+
+enum FilterType : uint8_t {
+  FILTER_NONE = 0,
+  FILTER_AVERAGE = 1,  // Mean of filterLength back-to-back conversions
+  FILTER_KALMAN = 2,   // Fixed-point Kalman over successive samples, ~filterLength samples of memory
+};
+
+struct DeviceConfig {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t autostart;     // Start measuring at power-up without waiting for 's'
+  uint8_t precision;     // Precision
+  uint8_t format;        // OutputFormat
+  uint32_t periodMs;     // Free-running sample period, 0 = sample on 'u' only
+  uint8_t filter;        // FilterType
+  uint8_t filterLength;  // Conversions per sample (FILTER_AVERAGE) or smoothing length (FILTER_KALMAN)
+  uint16_t adaptiveThreshold;  // Ticks/s of T or RH change that shorten the period, 0 = fixed period
+  uint32_t minPeriodMs;  // Adaptive lower bound, periodMs is the upper bound
+  uint8_t reserved[3];
+  uint8_t crc;           // CRC-8 over all preceding bytes
+};
+
+/**
+ * Fill in the default configuration
+ */
+void configDefaults(DeviceConfig *config);
+
+/**
+ * Load the stored configuration, returns false and loads the defaults
+ * if nothing valid is stored
+ */
+bool configLoad(DeviceConfig *config);
+
+/**
+ * Store the configuration in flash
+ */
+void configSave(DeviceConfig *config);
+
+/**
+ * Print the configuration as a comment line
+ */
+void configPrint(Print &out, const DeviceConfig &config);
+
+#endif  // DEVICE_CONFIG_H
@@ -0,0 +1,53 @@
+/*
+ * Compile-time feature selection
+ *
+ * Every optional subsystem is on by default. Build with e.g.
+ * -DFEATURE_LED=0 to compile it out entirely: its code, state, task,
+ * commands and capability tokens disappear, and with lib_ldf_mode = chain+
+ * its library is no longer linked. See the headless envs in platformio.ini.
+ */
+
+#ifndef FEATURE_FLAGS_H
+#define FEATURE_FLAGS_H
+
+// NeoPixel status LED (Adafruit NeoPixel)
+#ifndef FEATURE_LED
+#define FEATURE_LED 1
+#endif
+
+// Hardware watchdog with early-warning state save (watchdog_timer.h)
+#ifndef FEATURE_WATCHDOG
+#define FEATURE_WATCHDOG 1
+#endif
+
+// Heater decontamination, 'h'
+#ifndef FEATURE_DECONTAMINATION
+#define FEATURE_DECONTAMINATION 1
+#endif
+
+// CSV output, 'f0', pulls in float formatting
+#ifndef FEATURE_CSV
+#define FEATURE_CSV 1
+#endif
+
+// Binary raw-tick frames, 'f1'
+#ifndef FEATURE_BINARY
+#define FEATURE_BINARY 1
+#endif
+
+// Multi-sensor deployments: USB start-of-frame timebase shared by all
+// boards on a host, and the broadcast trigger 'k' / '*'
+#ifndef FEATURE_MULTI_SENSOR
+#define FEATURE_MULTI_SENSOR 1
+#endif
+
+// Bench diagnostics: Allan deviation 'v' (about 4 kB of RAM) and benchmark 'b'
+#ifndef FEATURE_DIAGNOSTICS
+#define FEATURE_DIAGNOSTICS 1
+#endif
+
+#if !FEATURE_CSV && !FEATURE_BINARY
+#error "At least one of FEATURE_CSV and FEATURE_BINARY is required"
+#endif
+
+#endif  // FEATURE_FLAGS_H
@@ -0,0 +1,31 @@
+/*
+ * Integer helpers shared by the on-device statistics
+ */
+
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stdint.h>
+
+/**
+ * Integer square root, rounded down
+ */
+inline uint32_t isqrt64(uint64_t value) {
+  uint64_t root = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+#endif  // FIXED_POINT_H
@@ -0,0 +1,58 @@
+/*
+ * Interrupt latency probe (RP2040)
+ *
+ * A spare timer alarm fires every ISR_PROBE_PERIOD_US and its handler reads
+ * the timer first thing, so entry time minus alarm target is the latency
+ * from the alarm to the handler running, at the 1 us resolution of the
+ * timer. Running alongside the tasks it sees the worst case under real
+ * load: USB interrupts, critical sections, clock switches and XIP cache
+ * misses. isrLatencyCold() flushes the XIP cache before each shot for the
+ * worst case of a handler that has to be fetched from flash.
+ *
+ * Built with FEATURE_DIAGNOSTICS on the RP2040, elsewhere the calls compile
+ * to nothing.
+ */
+
+#ifndef ISR_LATENCY_H
+#define ISR_LATENCY_H
+
+#include <Arduino.h>
+#include "feature_flags.h"
+
+#if FEATURE_DIAGNOSTICS && defined(ARDUINO_ARCH_RP2040)
+#define ISR_LATENCY_PROBE 1
+#else
+#define ISR_LATENCY_PROBE 0
+#endif
+
+struct IsrLatencyStats {
+  uint32_t maxUs;
+  uint32_t totalUs;
+  uint32_t count;
+};
+
+#if ISR_LATENCY_PROBE
+
+/**
+ * Claim a timer alarm and start the periodic probe
+ */
+void isrLatencyBegin();
+
+/**
+ * Print the periodic probe results as a comment line
+ */
+void isrLatencyPrint(Print &out);
+
+/**
+ * Pause the periodic probe and take shots with a cold XIP cache
+ */
+void isrLatencyCold(uint16_t shots, IsrLatencyStats *result);
+
+#else
+
+inline void isrLatencyBegin() {}
+inline void isrLatencyPrint(Print &) {}
+
+#endif  // ISR_LATENCY_PROBE
+
+#endif  // ISR_LATENCY_H
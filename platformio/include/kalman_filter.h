@@ -0,0 +1,49 @@
+/*
+ * Fixed-point scalar Kalman filter over raw SHT4x ticks
+ *
+ * Each channel is modelled as a random walk: process noise q per sample,
+ * measurement noise r from the sensor repeatability at the selected
+ * precision. Estimate and variances are kept in ticks with 8 fractional
+ * bits, the gain in Q16, so the update needs no floating point.
+ *
+ * Innovations (measurement minus prediction) are accumulated so the host
+ * can check the noise model: their mean should stay near zero and the
+ * normalised innovation squared (NIS) near one.
+ */
+
+#ifndef KALMAN_FILTER_H
+#define KALMAN_FILTER_H
+
+#include <Arduino.h>
+
+#define KALMAN_FRACTION_BITS  8
+#define KALMAN_GAIN_BITS      16
+
+struct KalmanChannel {
+  bool initialized;
+  int32_t estimate;     // Ticks, Q8
+  uint32_t variance;    // Estimate variance, ticks^2 Q8
+  // Innovation statistics since the last reset
+  uint32_t count;
+  int64_t innovationSum;       // Ticks, Q8
+  uint64_t innovationSquares;  // Ticks^2, Q16
+  uint64_t nisSum;             // Normalised innovation squared, Q8
+};
+
+/**
+ * Forget the state and statistics, the next update starts from its measurement
+ */
+void kalmanReset(KalmanChannel *channel);
+
+/**
+ * Fold one measurement into the estimate and return it rounded to ticks
+ * q and r are the process and measurement noise variances in ticks^2 Q8
+ */
+uint16_t kalmanUpdate(KalmanChannel *channel, uint16_t ticks, uint32_t q, uint32_t r);
+
+/**
+ * Print innovation count, mean and RMS in ticks and the mean NIS
+ */
+void kalmanPrintStats(Print &out, const char *name, const KalmanChannel &channel);
+
+#endif  // KALMAN_FILTER_H
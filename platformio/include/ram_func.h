@@ -0,0 +1,27 @@
+/*
+ * Hot-path placement in SRAM
+ *
+ * The RP2040 executes from QSPI flash through a 16 kB XIP cache, so a cache
+ * miss in an interrupt handler or on the per-sample path stalls for a flash
+ * read. RAM_FUNC(name) places a function in SRAM instead, and keeps it out
+ * of line so a caller in flash does not inline it back. Used for the timer
+ * interrupt handlers, the sensor read completion, the sample ring and the
+ * binary encoder.
+ *
+ * Build with -DRAM_FUNC_IN_FLASH (env:trinkeyrp2040qt_xip) to leave them in
+ * flash and compare. The SAMD21 executes from internal flash at a fixed wait
+ * state, there it expands to the plain name.
+ */
+
+#ifndef RAM_FUNC_H
+#define RAM_FUNC_H
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_RP2040) && !defined(RAM_FUNC_IN_FLASH)
+#define RAM_FUNC(name) __no_inline_not_in_flash_func(name)
+#else
+#define RAM_FUNC(name) name
+#endif
+
+#endif  // RAM_FUNC_H
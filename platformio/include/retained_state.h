@@ -0,0 +1,55 @@
+/*
+ * Measurement state retained across a watchdog reset
+ *
+ * The watchdog early-warning handler fills `retained` and seals it just
+ * before the reset. It lives in RAM the C runtime neither initialises nor
+ * clears, so no flash is written from the interrupt: on the SAMD21 the
+ * region the project linker script reserves at the top of RAM, on the
+ * RP2040 the SDK's uninitialised RAM. After a watchdog reset setup()
+ * restores it, so the board keeps measuring with the same settings, continues its timestamps and
+ * sample numbering and still delivers the samples it had buffered.
+ */
+
+#ifndef RETAINED_STATE_H
+#define RETAINED_STATE_H
+
+#include <Arduino.h>
+#include "device_config.h"
+#include "sample_buffer.h"
+
+#define RETAINED_MAGIC   0x52544E44  // "RTND"
+#define RETAINED_SAMPLES 64          // Room for the whole sample buffer
+
+struct RetainedState {
+  uint32_t magic;
+  uint32_t elapsedMs;       // Measurement time at the early warning
+  uint32_t sequence;        // Samples produced since 's'
+  DeviceConfig config;      // Live settings, may differ from the saved ones
+  uint8_t mode;             // DeviceMode
+  uint8_t triggerArmed;
+  uint8_t overdueTask;      // Trace: task that missed its heartbeat, or SCHEDULER_NO_TASK
+  uint8_t runningTask;      // Trace: task interrupted by the early warning, or SCHEDULER_NO_TASK
+  uint8_t sampleCount;
+  Sample samples[RETAINED_SAMPLES];  // Oldest first, not yet sent to the host
+  uint8_t crc;
+};
+
+extern RetainedState retained;
+
+/**
+ * Seal `retained` with magic and CRC so it is accepted after the reset
+ * Called from the early-warning interrupt
+ */
+void retainedCommit();
+
+/**
+ * Load `retained` after a reset, false if nothing valid was kept
+ */
+bool retainedLoad();
+
+/**
+ * Invalidate `retained` once it has been restored
+ */
+void retainedClear();
+
+#endif  // RETAINED_STATE_H
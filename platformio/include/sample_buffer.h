@@ -0,0 +1,172 @@
+/*
+ * Sample record and fixed-size ring buffer between acquisition and output
+ */
+
+#ifndef SAMPLE_BUFFER_H
+#define SAMPLE_BUFFER_H
+
+#include <Arduino.h>
+#include "ram_func.h"
+
+struct Sample {
+  uint32_t timestamp;  // ms since measurement start, midpoint of the conversion window
+  uint16_t tTicks;     // Raw SHT4x temperature ticks
+  uint16_t rhTicks;    // Raw SHT4x humidity ticks
+  uint16_t sofFrame;   // USB frame number at the midpoint, SOF_INVALID without a host
+  uint16_t sofOffsetUs; // Time into that frame
+  uint16_t conversionUs; // Conversion window, all averaged conversions
+  uint16_t periodMs;   // Free-running period after this sample, changes are reported
+  uint16_t triggerLatencyUs; // Trigger receipt latency bound, SAMPLE_NOT_TRIGGERED otherwise
+  uint32_t sequence;   // Samples before this one since 's', a gap shows samples lost
+};
+
+#define SAMPLE_NOT_TRIGGERED 0xFFFF
+
+/**
+ * Index bookkeeping of RingBuffer, outside the template so RAM_FUNC takes
+ * effect (GCC ignores section attributes on template members) and the ring
+ * operations run from SRAM on the RP2040
+ */
+struct RingIndex {
+  explicit RingIndex(uint8_t capacity) : capacity(capacity) {}
+
+  // Step past the entry just written at head, dropping the oldest when full
+  void RAM_FUNC(pushed)() {
+    if (++head == capacity) {
+      head = 0;
+    }
+    if (count == capacity) {
+      if (++tail == capacity) {
+        tail = 0;
+      }
+      overruns++;
+    } else {
+      count++;
+    }
+  }
+
+  // Step past the entry just read at tail
+  void RAM_FUNC(popped)() {
+    if (++tail == capacity) {
+      tail = 0;
+    }
+    count--;
+  }
+
+  const uint8_t capacity;
+  uint8_t head = 0;
+  uint8_t tail = 0;
+  uint8_t count = 0;
+  uint32_t overruns = 0;
+};
+
+/**
+ * Single-producer/single-consumer ring, overwrites the oldest entry when full
+ */
+template <typename T, uint8_t N>
+class RingBuffer {
+ public:
+  bool empty() const { return index.count == 0; }
+  uint8_t size() const { return index.count; }
+  uint8_t capacity() const { return N; }
+  uint32_t dropped() const { return index.overruns; }
+
+  void clear() { index.head = index.tail = index.count = 0; }
+
+  void push(const T &item) {
+    buffer[index.head] = item;
+    index.pushed();
+  }
+
+  bool pop(T *item) {
+    if (index.count == 0) {
+      return false;
+    }
+    *item = buffer[index.tail];
+    index.popped();
+    return true;
+  }
+
+  // Copy up to max entries oldest first and leave them queued, only safe
+  // while producer and consumer are interrupted, e.g. to save state before
+  // a reset that may still be called off
+  uint8_t peekFromIsr(T *items, uint8_t max) const {
+    uint8_t count = index.count < max ? index.count : max;
+    uint8_t at = index.tail;
+    for (uint8_t i = 0; i < count; i++) {
+      items[i] = buffer[at];
+      if (++at == N) {
+        at = 0;
+      }
+    }
+    return count;
+  }
+
+ private:
+  T buffer[N];
+  RingIndex index{N};
+};
+
+#ifdef PIO_FRAMEWORK_ARDUINO_ENABLE_FREERTOS
+#include <FreeRTOS.h>
+#include <queue.h>
+#include <task.h>
+
+/**
+ * FreeRTOS queue with the RingBuffer interface, safe between cores
+ */
+template <typename T, uint8_t N>
+class QueueBuffer {
+ public:
+  QueueBuffer() { queue = xQueueCreateStatic(N, sizeof(T), storage, &control); }
+
+  bool empty() const { return uxQueueMessagesWaiting(queue) == 0; }
+  uint8_t size() const { return uxQueueMessagesWaiting(queue); }
+  uint8_t capacity() const { return N; }
+  uint32_t dropped() const { return overruns; }
+
+  void push(const T &item) {
+    // Make room by dropping the oldest entry, like RingBuffer does
+    while (xQueueSend(queue, &item, 0) != pdPASS) {
+      T oldest;
+      xQueueReceive(queue, &oldest, 0);
+      overruns++;
+    }
+  }
+
+  bool pop(T *item) { return xQueueReceive(queue, item, 0) == pdPASS; }
+
+  // FreeRTOS can only peek at the head, so pass every entry once through
+  // the queue, which leaves it in its original order. The critical section
+  // keeps the task on the other core out meanwhile
+  uint8_t peekFromIsr(T *items, uint8_t max) {
+    UBaseType_t state = taskENTER_CRITICAL_FROM_ISR();
+    UBaseType_t count = uxQueueMessagesWaitingFromISR(queue);
+    uint8_t copied = 0;
+    for (UBaseType_t i = 0; i < count; i++) {
+      T item;
+      xQueueReceiveFromISR(queue, &item, nullptr);
+      xQueueSendToBackFromISR(queue, &item, nullptr);
+      if (copied < max) {
+        items[copied++] = item;
+      }
+    }
+    taskEXIT_CRITICAL_FROM_ISR(state);
+    return copied;
+  }
+
+ private:
+  uint8_t storage[N * sizeof(T)];
+  StaticQueue_t control;
+  QueueHandle_t queue;
+  uint32_t overruns = 0;
+};
+
+template <typename T, uint8_t N>
+using SampleQueue = QueueBuffer<T, N>;
+#else
+template <typename T, uint8_t N>
+using SampleQueue = RingBuffer<T, N>;
+#endif
+
+#endif  // SAMPLE_BUFFER_H
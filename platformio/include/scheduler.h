@@ -0,0 +1,88 @@
+/*
+ * Cooperative run-to-completion scheduler
+ *
+ * Tasks are plain functions that must return quickly. A task is released
+ * either periodically or when another task wakes it (optionally after a
+ * delay). Among the released tasks the one with the lowest priority number
+ * runs first, ties are broken by the earliest deadline. A task that starts
+ * later than its release time plus its deadline counts as a deadline miss.
+ *
+ * With PIO_FRAMEWORK_ARDUINO_ENABLE_FREERTOS (RP2040 FreeRTOS-SMP build)
+ * the same table is run by scheduler_freertos.cpp instead: every entry
+ * becomes a FreeRTOS task pinned to its core, and schedulerWake() becomes
+ * a task notification.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+typedef void (*TaskFunction)();
+
+#define SCHEDULER_NO_TASK 0xFF
+
+struct Task {
+  const char *name;
+  uint8_t priority;      // 0 = most urgent
+  uint32_t periodMs;     // 0 = only runs when woken
+  uint32_t deadlineMs;   // Allowed release-to-start latency
+  TaskFunction run;
+  uint8_t core;          // Core the task is pinned to in the FreeRTOS build
+
+  // Runtime state
+  bool released;
+  uint32_t releaseAt;    // millis() at which the task becomes ready
+  uint32_t runs;
+  uint32_t deadlineMisses;
+  uint32_t maxLatencyMs;
+  uint32_t maxRunUs;
+  uint32_t totalRunUs;
+};
+
+/**
+ * Register the task table and release all periodic tasks
+ */
+void schedulerBegin(Task *tasks, uint8_t count);
+
+/**
+ * Release a task after delayMs; an earlier pending release is kept
+ */
+void schedulerWake(uint8_t taskId, uint32_t delayMs = 0);
+
+/**
+ * Drop a pending release of a task
+ */
+void schedulerCancel(uint8_t taskId);
+
+/**
+ * Run the most urgent ready task, returns false if nothing was ready
+ */
+bool schedulerRunOnce();
+
+/**
+ * Task currently running, SCHEDULER_NO_TASK between tasks
+ * Meant for interrupt handlers; with FreeRTOS, the task on the calling core
+ */
+uint8_t schedulerRunningTask();
+
+/**
+ * Protect state shared between tasks on different cores
+ * No-ops in the cooperative build, where tasks never preempt each other
+ */
+void schedulerLock();
+void schedulerUnlock();
+
+/**
+ * The same protection from interrupt context, e.g. the watchdog early
+ * warning; pass the returned state to schedulerUnlockFromIsr()
+ */
+uint32_t schedulerLockFromIsr();
+void schedulerUnlockFromIsr(uint32_t state);
+
+/**
+ * Print per-task statistics as comment lines
+ */
+void schedulerPrintStats(Print &out);
+
+#endif  // SCHEDULER_H
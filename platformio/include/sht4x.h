@@ -0,0 +1,136 @@
+/*
+ * Lean SHT4x driver
+ *
+ * Talks to the sensor over Wire directly instead of going through
+ * Adafruit_SHT4x and the unified-sensor layer. Every command is one byte and
+ * every answer two 16-bit words, each followed by a Sensirion CRC-8.
+ * Measurements return raw ticks; conversion to degC / %RH is left to the
+ * caller or the host.
+ *
+ * The measurement command and conversion time are compile-time traits of the
+ * precision, so sht4xMeasure<P>() compiles down to two bus transactions and a
+ * fixed wait. Callers with a runtime precision index the tables built from
+ * the same traits.
+ */
+
+#ifndef SHT4X_H
+#define SHT4X_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "binary_protocol.h"  // crc8, the sensor uses the same polynomial
+#include "ram_func.h"
+
+#define SHT4X_ADDRESS        0x44
+
+// Commands
+#define SHT4X_HEATER_HIGH_1S 0x39  // 200 mW for 1 s, then a high precision measurement
+#define SHT4X_READ_SERIAL    0x89
+#define SHT4X_SOFT_RESET     0x94
+
+#define SHT4X_SOFT_RESET_US  1000  // Datasheet max soft reset time
+#define SHT4X_READ_SERIAL_MS 10    // Same wait as Sensirion's reference driver
+
+enum Sht4xPrecision : uint8_t {
+  SHT4X_PRECISION_HIGH,
+  SHT4X_PRECISION_MEDIUM,
+  SHT4X_PRECISION_LOW
+};
+
+// Measurement command and datasheet max conversion time per precision
+template <uint8_t P> struct Sht4xMeasurement;
+
+template <> struct Sht4xMeasurement<SHT4X_PRECISION_HIGH> {
+  static const uint8_t command = 0xFD;
+  static const uint16_t conversionUs = 8300;
+};
+
+template <> struct Sht4xMeasurement<SHT4X_PRECISION_MEDIUM> {
+  static const uint8_t command = 0xF6;
+  static const uint16_t conversionUs = 4500;
+};
+
+template <> struct Sht4xMeasurement<SHT4X_PRECISION_LOW> {
+  static const uint8_t command = 0xE0;
+  static const uint16_t conversionUs = 1600;
+};
+
+/**
+ * Send a measurement, heater or housekeeping command
+ */
+inline bool sht4xSendCommand(uint8_t command) {
+  Wire.beginTransmission(SHT4X_ADDRESS);
+  Wire.write(command);
+  return Wire.endTransmission() == 0;
+}
+
+/**
+ * Read the two CRC-checked words of the last command, for a measurement
+ * the raw T and RH ticks
+ * Returns false if the sensor NACKs (still busy) or a CRC fails
+ * Runs from SRAM on the RP2040, the Wire calls it makes do not
+ */
+inline bool RAM_FUNC(sht4xReadTicks)(uint16_t *first, uint16_t *second) {
+  if (Wire.requestFrom(SHT4X_ADDRESS, 6) != 6) {
+    return false;
+  }
+  uint8_t data[6];
+  for (uint8_t i = 0; i < 6; i++) {
+    data[i] = Wire.read();
+  }
+  if (crc8(data, 2) != data[2] || crc8(data + 3, 2) != data[5]) {
+    return false;
+  }
+
+  *first = (uint16_t)data[0] << 8 | data[1];
+  *second = (uint16_t)data[3] << 8 | data[4];
+  return true;
+}
+
+/**
+ * Start the bus and soft-reset the sensor, false if nothing ACKs
+ */
+inline bool sht4xBegin() {
+  Wire.begin();
+  if (!sht4xSendCommand(SHT4X_SOFT_RESET)) {
+    return false;
+  }
+  delayMicroseconds(SHT4X_SOFT_RESET_US);
+  return true;
+}
+
+/**
+ * Read the 32-bit serial number, blocking for SHT4X_READ_SERIAL_MS
+ */
+inline bool sht4xReadSerial(uint32_t *serialNumber) {
+  uint16_t high, low;
+  if (!sht4xSendCommand(SHT4X_READ_SERIAL)) {
+    return false;
+  }
+  delay(SHT4X_READ_SERIAL_MS);
+  if (!sht4xReadTicks(&high, &low)) {
+    return false;
+  }
+  *serialNumber = (uint32_t)high << 16 | low;
+  return true;
+}
+
+/**
+ * Start a measurement at precision P, read it after its conversionUs
+ */
+template <uint8_t P> inline bool sht4xStartMeasurement() {
+  return sht4xSendCommand(Sht4xMeasurement<P>::command);
+}
+
+/**
+ * Blocking measurement at precision P: command, conversion wait, read
+ */
+template <uint8_t P> inline bool sht4xMeasure(uint16_t *tTicks, uint16_t *rhTicks) {
+  if (!sht4xStartMeasurement<P>()) {
+    return false;
+  }
+  delayMicroseconds(Sht4xMeasurement<P>::conversionUs);
+  return sht4xReadTicks(tTicks, rhTicks);
+}
+
+#endif  // SHT4X_H
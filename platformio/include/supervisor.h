@@ -0,0 +1,59 @@
+/*
+ * Per-task liveness supervision
+ *
+ * A supervised task reports a heartbeat whenever it makes progress, together
+ * with the deadline for its next one. The watchdog task checks all armed
+ * heartbeats and feeds the hardware watchdog only while every one is on
+ * time, so a task that stops making progress resets the board within its
+ * own deadline plus a short hardware timeout. Tasks that wait on an
+ * external event (a host command) report idle and are not checked.
+ *
+ * Without FEATURE_WATCHDOG the calls compile to nothing.
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <Arduino.h>
+#include "feature_flags.h"
+
+#define SUPERVISOR_MAX_TASKS 16
+#define SUPERVISOR_HEALTHY   0xFF  // supervisorCheck(): no heartbeat overdue
+
+#if FEATURE_WATCHDOG
+
+/**
+ * The task made progress and reports again within deadlineMs
+ */
+void heartbeat(uint8_t taskId, uint32_t deadlineMs);
+
+/**
+ * The task waits for an external event, stop checking it
+ */
+void heartbeatIdle(uint8_t taskId);
+
+/**
+ * Return the first task whose heartbeat is overdue, or SUPERVISOR_HEALTHY
+ */
+uint8_t supervisorCheck();
+
+/**
+ * Move every armed deadline ms later, after the caller held up the other
+ * tasks on purpose
+ */
+void supervisorPostpone(uint32_t ms);
+
+/**
+ * supervisorCheck() for interrupt handlers
+ */
+uint8_t supervisorCheckFromIsr();
+
+#else
+
+inline void heartbeat(uint8_t, uint32_t) {}
+inline void heartbeatIdle(uint8_t) {}
+inline void supervisorPostpone(uint32_t) {}
+
+#endif  // FEATURE_WATCHDOG
+
+#endif  // SUPERVISOR_H
@@ -0,0 +1,50 @@
+/*
+ * USB start-of-frame timebase
+ *
+ * The host sends a start-of-frame token every 1 ms and all devices on the
+ * same bus see the same 11-bit frame number. Latching it, plus the time
+ * since the frame began, at every sample gives the host a common timebase
+ * for all boards without any sync traffic.
+ *
+ * Neither chip timestamps the SOF in hardware, so the frame edge is found
+ * by polling the frame number (usbTimebaseCalibrate) and the sub-frame
+ * offset is extrapolated from micros() until the next calibration.
+ */
+
+#ifndef USB_TIMEBASE_H
+#define USB_TIMEBASE_H
+
+#include <Arduino.h>
+
+#define SOF_FRAME_MASK     0x7FF   // 11-bit frame number, wraps every 2.048 s
+#define SOF_FRAME_US       1000
+#define SOF_INVALID        0xFFFF  // No frames seen, e.g. not enumerated
+#define SOF_CALIBRATE_MS   1000    // Re-find the frame edge this often
+
+struct SofStamp {
+  uint16_t frame;     // USB frame number, SOF_INVALID without a host
+  uint16_t offsetUs;  // Time since the start of that frame
+};
+
+/**
+ * Current USB frame number as counted by the device controller
+ */
+uint16_t usbFrameNumber();
+
+/**
+ * Busy-wait for the next frame edge (at most ~1 ms) and remember its
+ * micros(), returns false if the frame number does not advance
+ */
+bool usbTimebaseCalibrate();
+
+/**
+ * Frame number and sub-frame offset of the current instant
+ */
+SofStamp usbTimebaseLatch();
+
+/**
+ * Stamp of an instant us microseconds after stamp, invalid stays invalid
+ */
+SofStamp sofAdvance(SofStamp stamp, uint32_t us);
+
+#endif  // USB_TIMEBASE_H
@@ -0,0 +1,39 @@
+/*
+ * Hardware watchdog with an early warning
+ *
+ * Drives the SAMD21 WDT and the RP2040 watchdog directly. Halfway through
+ * the timeout without a feed, the early-warning handler runs in interrupt
+ * context: the SAMD21 WDT early-warning interrupt, on the RP2040 (whose
+ * watchdog has none) a hardware timer alarm re-armed on every feed. The
+ * handler has the other half of the timeout to save state before the reset.
+ */
+
+#ifndef WATCHDOG_TIMER_H
+#define WATCHDOG_TIMER_H
+
+#include <Arduino.h>
+
+typedef void (*WatchdogWarning)();
+
+/**
+ * Start the watchdog, returns the actual timeout in ms
+ * The warning handler, if any, must be set before
+ */
+int watchdogEnable(uint32_t timeoutMs);
+
+/**
+ * Restart the timeout and the early warning
+ */
+void watchdogFeed();
+
+/**
+ * Run handler from the early-warning interrupt, nullptr for none
+ */
+void watchdogSetWarning(WatchdogWarning handler);
+
+/**
+ * Whether the last reset was caused by the watchdog
+ */
+bool watchdogCausedReset();
+
+#endif  // WATCHDOG_TIMER_H
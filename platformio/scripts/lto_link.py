@@ -0,0 +1,6 @@
+# PlatformIO passes -flto from build_flags to the compiler only. The link
+# step needs it too, with the same optimisation level, or the LTO objects
+# are linked without whole-program optimisation.
+Import("env")
+
+env.Append(LINKFLAGS=["-flto", "-O2"])
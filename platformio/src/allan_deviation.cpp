@@ -0,0 +1,68 @@
+#include "allan_deviation.h"
+#include "feature_flags.h"
+
+#if FEATURE_DIAGNOSTICS
+#include "fixed_point.h"
+
+void allanReset(AllanBuffer *buffer) {
+  buffer->count = 0;
+  buffer->tSums[0] = 0;
+  buffer->rhSums[0] = 0;
+}
+
+bool allanAdd(AllanBuffer *buffer, uint16_t tTicks, uint16_t rhTicks) {
+  if (buffer->count >= ALLAN_MAX_SAMPLES) {
+    return false;
+  }
+  uint16_t n = buffer->count;
+  buffer->tSums[n + 1] = buffer->tSums[n] + tTicks;
+  buffer->rhSums[n + 1] = buffer->rhSums[n] + rhTicks;
+  buffer->count++;
+  return true;
+}
+
+uint32_t allanDeviationCenti(const uint32_t *sums, uint16_t count, uint16_t m) {
+  if (m == 0 || 2U * m > count) {
+    return 0;
+  }
+  uint32_t terms = count - 2U * m + 1;
+  uint64_t squares = 0;
+  for (uint32_t j = 0; j < terms; j++) {
+    // Difference of two adjacent m-sample sums
+    int32_t diff = (int32_t)(sums[j + 2 * m] - 2 * sums[j + m] + sums[j]);
+    squares += (uint64_t)((int64_t)diff * diff);
+  }
+  // Scale by 100^2 before dividing so the square root comes out in centi-ticks
+  uint64_t denominator = 2ULL * m * m * terms;
+  if (squares > UINT64_MAX / 10000ULL) {
+    return isqrt64(squares / denominator) * 100;  // Drifting series, whole ticks suffice
+  }
+  return isqrt64((squares * 10000ULL + denominator / 2) / denominator);
+}
+
+static void printCenti(Print &out, uint32_t centi) {
+  out.print(centi / 100);
+  out.print('.');
+  if (centi % 100 < 10) {
+    out.print('0');
+  }
+  out.print(centi % 100);
+}
+
+void allanPrint(Print &out, const AllanBuffer &buffer, uint8_t precision, uint32_t tau0Ms) {
+  out.println("# Allan deviation, precision, tau (ms), T (ticks), RH (ticks), samples");
+  for (uint16_t m = 1; 2U * m <= buffer.count; m *= 2) {
+    out.print("# adev, ");
+    out.print(precision);
+    out.print(", ");
+    out.print(tau0Ms * m);
+    out.print(", ");
+    printCenti(out, allanDeviationCenti(buffer.tSums, buffer.count, m));
+    out.print(", ");
+    printCenti(out, allanDeviationCenti(buffer.rhSums, buffer.count, m));
+    out.print(", ");
+    out.println(buffer.count);
+  }
+}
+
+#endif  // FEATURE_DIAGNOSTICS
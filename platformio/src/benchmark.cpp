@@ -0,0 +1,22 @@
+#include "benchmark.h"
+#include "feature_flags.h"
+
+#if FEATURE_DIAGNOSTICS
+
+void benchmarkRun(Print &out, const char *name, BenchmarkOp op, uint16_t iterations) {
+  op();  // Warm up caches and lazy initialisation
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < iterations; i++) {
+    op();
+  }
+  benchmarkPrintResult(out, name, micros() - start, iterations);
+}
+
+void benchmarkPrintResult(Print &out, const char *name, uint32_t totalUs, uint16_t iterations) {
+  out.print("# bench, ");
+  out.print(name);
+  out.print(", ");
+  out.println((uint32_t)((uint64_t)totalUs * 1000 / iterations));
+}
+
+#endif  // FEATURE_DIAGNOSTICS
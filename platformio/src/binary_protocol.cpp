@@ -0,0 +1,57 @@
+#include "binary_protocol.h"
+#include "ram_func.h"
+
+// The whole encoder runs from SRAM on the RP2040, see ram_func.h
+
+uint8_t RAM_FUNC(crc8)(const uint8_t *data, size_t len) {
+  uint8_t crc = 0xFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static uint8_t *RAM_FUNC(put16)(uint8_t *p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+  return p + 2;
+}
+
+static uint8_t *RAM_FUNC(put32)(uint8_t *p, uint32_t value) {
+  p = put16(p, value & 0xFFFF);
+  return put16(p, value >> 16);
+}
+
+void RAM_FUNC(writeFrame)(Print &out, uint8_t type, const uint8_t *payload, uint8_t len) {
+  // Assemble the whole frame first so it leaves in a single USB packet
+  uint8_t frame[FRAME_MAX_PAYLOAD + 5];
+  if (len > FRAME_MAX_PAYLOAD) {
+    return;
+  }
+  frame[0] = FRAME_SYNC_0;
+  frame[1] = FRAME_SYNC_1;
+  frame[2] = type;
+  frame[3] = len;
+  memcpy(frame + 4, payload, len);
+  frame[4 + len] = crc8(frame + 2, len + 2);
+  out.write(frame, len + 5);
+}
+
+void RAM_FUNC(writeRawSampleFrame)(Print &out, uint32_t serialNumber, uint32_t timestamp,
+                         uint16_t tTicks, uint16_t rhTicks,
+                         uint16_t sofFrame, uint16_t sofOffsetUs, uint16_t conversionUs,
+                         uint32_t sequence) {
+  uint8_t payload[22];
+  uint8_t *p = put32(payload, serialNumber);
+  p = put32(p, timestamp);
+  p = put16(p, tTicks);
+  p = put16(p, rhTicks);
+  p = put16(p, sofFrame);
+  p = put16(p, sofOffsetUs);
+  p = put16(p, conversionUs);
+  put32(p, sequence);
+  writeFrame(out, FRAME_TYPE_RAW_SOF, payload, sizeof(payload));
+}
@@ -0,0 +1,31 @@
+#include "boot_profile.h"
+
+static uint32_t bootPhaseUs[BOOT_PHASE_COUNT];
+static bool bootPhaseReached[BOOT_PHASE_COUNT];
+
+static const char *const bootPhaseNames[BOOT_PHASE_COUNT] = {
+  "pixel", "sensor", "serialNumber", "config", "scheduler", "firstSample",
+  "usbConfigured", "portOpen"
+};
+
+void bootMark(BootPhase phase) {
+  if (!bootPhaseReached[phase]) {
+    bootPhaseUs[phase] = micros();
+    bootPhaseReached[phase] = true;
+  }
+}
+
+void bootPrintProfile(Print &out) {
+  out.print("# Boot (us since reset):");
+  for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) {
+    out.print(i == 0 ? " " : ", ");
+    out.print(bootPhaseNames[i]);
+    out.print("=");
+    if (bootPhaseReached[i]) {
+      out.print(bootPhaseUs[i]);
+    } else {
+      out.print("-");
+    }
+  }
+  out.println();
+}
@@ -0,0 +1,154 @@
+#include "clock_scaling.h"
+
+#if CLOCK_SCALING
+#include <Wire.h>
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/vreg.h"
+
+#define CLOCK_IDLE_KHZ        48000  // clk_sys straight from the USB PLL
+#define CLOCK_VREG_SETTLE_US  100    // Core voltage rise before the clock goes up
+#define CLOCK_I2C_HZ          100000 // Wire default, its divider follows clk_sys
+
+// Energy model: supply current = base + PLL + per-MHz core current, the
+// core part scaling with the core voltage. Typical RP2040 figures, good for
+// comparing settings rather than as a measurement.
+#define CLOCK_SUPPLY_MV       5000   // From VBUS, all regulators are linear
+#define CLOCK_BASE_UA         6000   // Crystal, USB PLL and PHY, flash, sensor idle
+#define CLOCK_PLL_SYS_UA      700
+#define CLOCK_CORE_UA_PER_MHZ 140    // At 1.10 V
+
+enum ClockLevel : uint8_t {
+  CLOCK_LEVEL_IDLE,
+  CLOCK_LEVEL_BURST,
+  CLOCK_LEVEL_COUNT
+};
+
+struct ClockSetting {
+  uint32_t khz;
+  uint16_t coreMv;
+  bool pllSys;
+};
+
+static ClockSetting settings[CLOCK_LEVEL_COUNT] = {
+  {CLOCK_IDLE_KHZ, 1000, false},
+  {0, 1100, true},  // Full clock filled in by clockBegin()
+};
+
+static ClockLevel level = CLOCK_LEVEL_BURST;
+static bool begun = false;
+static uint32_t levelSince;                  // micros() of the last switch
+static uint64_t levelUs[CLOCK_LEVEL_COUNT];  // Time per level since clockResetStats()
+static uint32_t samplesDone;
+static uint32_t switches;
+
+// Add the time since the last switch to the current level
+static void accountLevel() {
+  uint32_t now = micros();
+  levelUs[level] += now - levelSince;
+  levelSince = now;
+}
+
+static void enterLevel(ClockLevel next) {
+  accountLevel();
+  level = next;
+  switches++;
+}
+
+// Peripherals keep 48 MHz from the USB PLL whatever clk_sys does
+static void pinPeripheralClock() {
+  clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                  CLOCK_IDLE_KHZ * KHZ, CLOCK_IDLE_KHZ * KHZ);
+}
+
+void clockBegin() {
+  settings[CLOCK_LEVEL_BURST].khz = clock_get_hz(clk_sys) / KHZ;
+  pinPeripheralClock();
+  levelSince = micros();
+  begun = true;
+}
+
+void clockIdle() {
+  if (!begun || level == CLOCK_LEVEL_IDLE) {
+    return;
+  }
+  // Lower the clock first, then the voltage
+  clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                  CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                  CLOCK_IDLE_KHZ * KHZ, CLOCK_IDLE_KHZ * KHZ);
+  pll_deinit(pll_sys);
+  vreg_set_voltage(VREG_VOLTAGE_1_00);
+  Wire.setClock(CLOCK_I2C_HZ);
+  enterLevel(CLOCK_LEVEL_IDLE);
+}
+
+void clockBurst() {
+  if (!begun || level == CLOCK_LEVEL_BURST) {
+    return;
+  }
+  // Raise the voltage first, then the clock
+  vreg_set_voltage(VREG_VOLTAGE_DEFAULT);
+  delayMicroseconds(CLOCK_VREG_SETTLE_US);
+  set_sys_clock_khz(settings[CLOCK_LEVEL_BURST].khz, true);
+  pinPeripheralClock();
+  Wire.setClock(CLOCK_I2C_HZ);
+  enterLevel(CLOCK_LEVEL_BURST);
+}
+
+void clockResetStats() {
+  levelSince = micros();
+  for (uint8_t i = 0; i < CLOCK_LEVEL_COUNT; i++) {
+    levelUs[i] = 0;
+  }
+  samplesDone = 0;
+  switches = 0;
+}
+
+void clockSampleDone() {
+  samplesDone++;
+}
+
+// Modelled supply current at one level in uA
+static uint32_t levelCurrentUa(const ClockSetting &s) {
+  uint32_t coreUa = (uint64_t)CLOCK_CORE_UA_PER_MHZ * s.khz / 1000 * s.coreMv / 1100;
+  return CLOCK_BASE_UA + (s.pllSys ? CLOCK_PLL_SYS_UA : 0) + coreUa;
+}
+
+void clockPrintStats(Print &out) {
+  accountLevel();
+
+  uint64_t totalUs = 0;
+  float energyMj = 0;
+  for (uint8_t i = 0; i < CLOCK_LEVEL_COUNT; i++) {
+    totalUs += levelUs[i];
+    // uA * us * mV = 1e-15 J
+    energyMj += (float)levelCurrentUa(settings[i]) * levelUs[i] * CLOCK_SUPPLY_MV * 1e-12f;
+  }
+  if (totalUs == 0) {
+    return;
+  }
+
+  out.print("# Clock: ");
+  for (uint8_t i = 0; i < CLOCK_LEVEL_COUNT; i++) {
+    out.print(settings[i].khz / 1000);
+    out.print(" MHz ");
+    out.print(settings[i].coreMv / 1000.0f);
+    out.print(" V ");
+    out.print(100.0f * levelUs[i] / totalUs, 1);
+    out.print(" %, ");
+  }
+  out.print(switches);
+  out.print(" switches, ~");
+  out.print(energyMj * 1e6f / totalUs, 0);  // mJ per s = mW
+  out.print(" mW (full clock ~");
+  out.print(levelCurrentUa(settings[CLOCK_LEVEL_BURST]) * CLOCK_SUPPLY_MV * 1e-6f, 0);  // uA * mV = 1e-6 mW
+  out.print(" mW)");
+  if (samplesDone > 0) {
+    out.print(", ~");
+    out.print(energyMj / samplesDone, 2);
+    out.print(" mJ/sample");
+  }
+  out.println(" (model)");
+}
+
+#endif  // CLOCK_SCALING
@@ -0,0 +1,80 @@
+#include <stddef.h>
+#include "device_config.h"
+#include "binary_protocol.h"
+#include "feature_flags.h"
+
+#if defined(ARDUINO_ARCH_SAMD)
+#include <FlashStorage.h>
+FlashStorage(configStorage, DeviceConfig);
+#elif defined(ARDUINO_ARCH_RP2040)
+#include <EEPROM.h>
+#define CONFIG_EEPROM_SIZE 256
+#endif
+
+static uint8_t configCrc(const DeviceConfig &config) {
+  return crc8((const uint8_t *)&config, offsetof(DeviceConfig, crc));
+}
+
+void configDefaults(DeviceConfig *config) {
+  memset(config, 0, sizeof(*config));
+  config->magic = CONFIG_MAGIC;
+  config->version = CONFIG_VERSION;
+  config->autostart = 0;
+  config->precision = PRECISION_HIGH;
+  config->format = FEATURE_CSV ? FORMAT_CSV : FORMAT_BINARY;
+  config->periodMs = 0;
+  config->filter = FILTER_NONE;
+  config->filterLength = 1;
+  config->adaptiveThreshold = 0;
+  config->minPeriodMs = 100;
+}
+
+bool configLoad(DeviceConfig *config) {
+#if defined(ARDUINO_ARCH_SAMD)
+  *config = configStorage.read();
+#elif defined(ARDUINO_ARCH_RP2040)
+  EEPROM.begin(CONFIG_EEPROM_SIZE);
+  EEPROM.get(0, *config);
+#else
+  config->magic = 0;
+#endif
+
+  if (config->magic != CONFIG_MAGIC || config->version != CONFIG_VERSION ||
+      config->crc != configCrc(*config)) {
+    configDefaults(config);
+    return false;
+  }
+  return true;
+}
+
+void configSave(DeviceConfig *config) {
+  config->magic = CONFIG_MAGIC;
+  config->version = CONFIG_VERSION;
+  config->crc = configCrc(*config);
+#if defined(ARDUINO_ARCH_SAMD)
+  configStorage.write(*config);
+#elif defined(ARDUINO_ARCH_RP2040)
+  EEPROM.put(0, *config);
+  EEPROM.commit();
+#endif
+}
+
+void configPrint(Print &out, const DeviceConfig &config) {
+  out.print("# Config: autostart=");
+  out.print(config.autostart);
+  out.print(", period=");
+  out.print(config.periodMs);
+  out.print(" ms, precision=");
+  out.print(config.precision);
+  out.print(", format=");
+  out.print(config.format);
+  out.print(", filter=");
+  out.print(config.filter);
+  out.print(", filterLength=");
+  out.print(config.filterLength);
+  out.print(", adaptive=");
+  out.print(config.adaptiveThreshold);
+  out.print(" ticks/s, minPeriod=");
+  out.print(config.minPeriodMs);
+  out.println(" ms");
+}
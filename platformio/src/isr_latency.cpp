@@ -0,0 +1,99 @@
+#include "isr_latency.h"
+
+#if ISR_LATENCY_PROBE
+#include "hardware/irq.h"
+#include "hardware/structs/timer.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "hardware/timer.h"
+#include "ram_func.h"
+
+#define ISR_PROBE_PERIOD_US 9973  // Prime, drifts across USB frames and task periods
+#define ISR_COLD_LEAD_US    50    // Cold shot fires this long after arming
+#define ISR_COLD_TIMEOUT_US 10000
+
+static int probeAlarm = -1;
+static volatile uint32_t probeTarget;
+static volatile bool probePeriodic = false;
+static volatile bool probeFired;
+static IsrLatencyStats periodicStats;
+static IsrLatencyStats *volatile recording = &periodicStats;
+
+// Also called from probeIsr(), so it runs from SRAM like the handler
+static void RAM_FUNC(arm)(uint32_t target) {
+  probeTarget = target;
+  timer_hw->alarm[probeAlarm] = target;
+}
+
+static void RAM_FUNC(probeIsr)() {
+  uint32_t now = timer_hw->timerawl;  // First, everything after adds latency
+  timer_hw->intr = 1u << probeAlarm;
+
+  uint32_t latencyUs = now - probeTarget;
+  IsrLatencyStats *stats = recording;
+  stats->totalUs += latencyUs;
+  stats->count++;
+  if (latencyUs > stats->maxUs) {
+    stats->maxUs = latencyUs;
+  }
+
+  if (probePeriodic) {
+    uint32_t next = probeTarget + ISR_PROBE_PERIOD_US;
+    if ((int32_t)(next - now) <= 0) {
+      next = now + ISR_PROBE_PERIOD_US;
+    }
+    arm(next);
+  }
+  probeFired = true;
+}
+
+void isrLatencyBegin() {
+  probeAlarm = hardware_alarm_claim_unused(true);
+  irq_set_exclusive_handler(TIMER_IRQ_0 + probeAlarm, probeIsr);
+  hw_set_bits(&timer_hw->inte, 1u << probeAlarm);
+  irq_set_enabled(TIMER_IRQ_0 + probeAlarm, true);
+  probePeriodic = true;
+  arm(timer_hw->timerawl + ISR_PROBE_PERIOD_US);
+}
+
+void isrLatencyPrint(Print &out) {
+  noInterrupts();
+  IsrLatencyStats stats = periodicStats;
+  interrupts();
+  if (stats.count == 0) {
+    return;
+  }
+  out.print("# ISR latency: max ");
+  out.print(stats.maxUs);
+  out.print(" us, mean ");
+  out.print((uint32_t)((uint64_t)stats.totalUs * 1000 / stats.count));
+  out.print(" ns over ");
+  out.print(stats.count);
+  out.println(" probes");
+}
+
+void isrLatencyCold(uint16_t shots, IsrLatencyStats *result) {
+  *result = IsrLatencyStats();
+  if (probeAlarm < 0) {
+    return;
+  }
+  // Stop the periodic probe, a pending shot fires into the periodic stats
+  probePeriodic = false;
+  uint32_t start = timer_hw->timerawl;
+  while (timer_hw->timerawl - start < ISR_PROBE_PERIOD_US + ISR_COLD_LEAD_US);
+  recording = result;
+
+  for (uint16_t i = 0; i < shots; i++) {
+    probeFired = false;
+    xip_ctrl_hw->flush = 1;
+    (void)xip_ctrl_hw->flush;  // Read blocks until the flush is done
+    arm(timer_hw->timerawl + ISR_COLD_LEAD_US);
+    start = timer_hw->timerawl;
+    while (!probeFired && timer_hw->timerawl - start < ISR_COLD_TIMEOUT_US);
+  }
+
+  recording = &periodicStats;
+  probePeriodic = true;
+  arm(timer_hw->timerawl + ISR_PROBE_PERIOD_US);
+}
+
+#endif  // ISR_LATENCY_PROBE
@@ -0,0 +1,57 @@
+#include "kalman_filter.h"
+#include "fixed_point.h"
+
+void kalmanReset(KalmanChannel *channel) {
+  memset(channel, 0, sizeof(*channel));
+}
+
+uint16_t kalmanUpdate(KalmanChannel *channel, uint16_t ticks, uint32_t q, uint32_t r) {
+  int32_t measurement = (int32_t)ticks << KALMAN_FRACTION_BITS;
+  if (!channel->initialized) {
+    channel->estimate = measurement;
+    channel->variance = r;
+    channel->initialized = true;
+    return ticks;
+  }
+
+  // Predict: the random walk only adds uncertainty
+  uint32_t variance = channel->variance + q;
+  uint32_t innovationVariance = variance + r;
+  int32_t innovation = measurement - channel->estimate;
+
+  // Correct
+  uint32_t gain = ((uint64_t)variance << KALMAN_GAIN_BITS) / innovationVariance;
+  channel->estimate += ((int64_t)gain * innovation) >> KALMAN_GAIN_BITS;
+  channel->variance = variance - (((uint64_t)gain * variance) >> KALMAN_GAIN_BITS);
+
+  // Innovation statistics, NIS = innovation^2 / innovation variance. Kept
+  // in fixed point, innovations are mostly below one tick
+  uint64_t innovationSquared = (int64_t)innovation * innovation;  // Q16
+  channel->count++;
+  channel->innovationSum += innovation;
+  channel->innovationSquares += innovationSquared;
+  channel->nisSum += innovationSquared / innovationVariance;
+
+  int32_t rounded = (channel->estimate + (1 << (KALMAN_FRACTION_BITS - 1))) >> KALMAN_FRACTION_BITS;
+  return constrain(rounded, (int32_t)0, (int32_t)0xFFFF);
+}
+
+void kalmanPrintStats(Print &out, const char *name, const KalmanChannel &channel) {
+  out.print("# Kalman ");
+  out.print(name);
+  out.print(": n=");
+  out.print(channel.count);
+  if (channel.count == 0) {
+    out.println();
+    return;
+  }
+  out.print(", innovation mean=");
+  out.print((double)channel.innovationSum / channel.count / (1 << KALMAN_FRACTION_BITS));
+  out.print(" rms=");
+  out.print(isqrt64(channel.innovationSquares / channel.count) / 256.0);  // sqrt of Q16 is Q8
+  out.print(" ticks, nis=");
+  out.print((double)(channel.nisSum / channel.count) / (1 << KALMAN_FRACTION_BITS));
+  out.print(", sd=");
+  out.print(isqrt64(channel.variance) / 16.0);  // sqrt of Q8 is Q4
+  out.println(" ticks");
+}
@@ -1,13 +1,25 @@
 /*
  * Adafruit SHT4x Trinkey Humidity/Temperature Sensor Logger
- * 
+ *
  * This program interfaces with the SHT4x sensor on the Adafruit Trinkey
  * to log temperature and humidity readings. Features include:
  * - Serial communication for data logging
  * - NeoPixel status indication
  * - Watchdog timer for reliability
  * - Sensor decontamination heating
- * 
+ *
+ * All work is split into short run-to-completion tasks (command RX,
+ * acquisition, output, LED, watchdog, heater) driven by a cooperative
+ * scheduler, so no concern blocks the others while it waits on the sensor.
+ * Sensor sequences are written as stackless coroutines (coroutine.h) that
+ * suspend on timers instead of calling delay().
+ *
+ * Settings (autostart, period, precision, format, filter) persist in flash.
+ * With autostart set the board measures from power-up, buffers samples while
+ * no USB host is connected and streams them once one opens the port.
+ * Boot phases are timestamped (boot_profile.h) and reported with the banner.
+ * Optional subsystems can be compiled out with the flags in feature_flags.h.
+ *
  * LED Status Colors:
  * - Blue: Initializing
  * - Gray: Ready/Waiting for commands
@@ -19,16 +31,79 @@
 
 #include <Arduino.h>
 #include <Wire.h>
-#include "Adafruit_SHT4x.h"
+#include "feature_flags.h"
+#if FEATURE_LED
 #include <Adafruit_NeoPixel.h>
-#include <Adafruit_SleepyDog.h>
+#endif
+#if FEATURE_DIAGNOSTICS
+#include "allan_deviation.h"
+#include "benchmark.h"
+#endif
+#include "binary_protocol.h"
+#include "boot_profile.h"
+#include "clock_scaling.h"
+#include "coroutine.h"
+#include "device_config.h"
+#include "isr_latency.h"
+#include "kalman_filter.h"
+#include "retained_state.h"
+#include "sample_buffer.h"
+#include "scheduler.h"
+#include "sht4x.h"
+#include "supervisor.h"
+#include "usb_timebase.h"
+#include "watchdog_timer.h"
+#if defined(ARDUINO_ARCH_RP2040)
+#include <tusb.h>
+#endif
+#if defined(BENCH_ADAFRUIT_SHT4X)
+#include "Adafruit_SHT4x.h"    // Reference for the 'b' benchmark only
+#endif
 
 // Constants
-#define SETUP_MSG "Send 's' to start measurement, 'n' to get serial number, 'h' for decontamination."
-#define WATCHDOG_TIMEOUT_MS 60000                    // 60 second watchdog timeout
+#define FIRMWARE_VERSION "1.2.0"
+#if FEATURE_DECONTAMINATION
+#define HELP_DECONTAMINATION ", 'h' for decontamination"
+#else
+#define HELP_DECONTAMINATION ""
+#endif
+#if FEATURE_CSV && FEATURE_BINARY
+#define HELP_FORMAT ", 'f0'/'f1' for CSV/binary output"
+#else
+#define HELP_FORMAT ""
+#endif
+#if FEATURE_DIAGNOSTICS
+#define HELP_DIAGNOSTICS " 'v<s>' Allan deviation over s seconds per precision, 'b' benchmark,"
+#else
+#define HELP_DIAGNOSTICS ""
+#endif
+#if FEATURE_MULTI_SENSOR
+#define HELP_TRIGGER ", 'k1'/'k0' arm/disarm '*' trigger"
+#else
+#define HELP_TRIGGER ""
+#endif
+#define SETUP_MSG "Send 's' to start measurement, 'n' to get serial number, 'c' for capabilities" HELP_DECONTAMINATION HELP_FORMAT "."
+#define CONFIG_MSG "# Config: 'a0'/'a1' autostart, 'r<ms>' sample period (0 = on 'u'), 'p0'-'p2' precision, 'm<n>' average n conversions, 'q<n>' Kalman over ~n samples, 'i' filter stats," HELP_DIAGNOSTICS " 'e<n>' adapt period above n ticks/s (0 = off), 'l<ms>' min adaptive period, 'g' show, 'w' save, 'x' stop measuring" HELP_TRIGGER "."
+#define WATCHDOG_TIMEOUT_MS 1000                      // Hardware timeout, the supervisor feeds it
 #define DEFAULT_DECONTAMINATION_MS (30 * 60 * 1000)  // 30 minutes default decontamination
 #define DECONTAMINATION_STATUS_INTERVAL 5000         // Status update interval during decontamination
 #define DECONTAM_SKIPS 30                             // Number of heating loops between reads
+#define HEATER_WAIT_MS 800                            // Wait before polling for the end of a 1 s heat pulse
+#define HEATER_READ_TIMEOUT_MS 1000                   // Max ACK wait after a heat pulse
+#define WATCHDOG_CHECK_MS 100                         // Supervisor check and feed period
+#define HEARTBEAT_MARGIN_MS 100                       // Slack on a task's expected next heartbeat
+#define COMMAND_HEARTBEAT_MS 100                      // Command RX runs every 2 ms
+#define HEATER_HEARTBEAT_MS (HEATER_WAIT_MS + HEATER_READ_TIMEOUT_MS + HEARTBEAT_MARGIN_MS)  // Per heat cycle
+#define ACQUISITION_MAX_FAILURES 10                   // Consecutive failed samples before the watchdog starves
+#define MAX_PERIOD_MS 30000                           // Longest free-running period
+#define COMMAND_ARG_TIMEOUT_MS 1000                   // Same as the Stream::parseInt() timeout
+#define COMMAND_RX_BUDGET 16                          // Max bytes handled per command task run
+#define LED_FLASH_MS 20                               // Measurement flash duration
+#define ALLAN_DEFAULT_S 60                            // 'v' duration per precision without argument
+#define ALLAN_MAX_S 3600
+#define TRIGGER_COMMAND '*'                          // Sample now, when armed with 'k1'
+#define SAMPLE_BUFFER_SIZE 64                         // Samples buffered for the output task / until a host connects
+#define REQUEST_QUEUE_LENGTH 8                        // Unserved 'u' and '*' requests
 
 // LED Color Definitions
 #define LED_INIT        0x0000FF  // Blue - Initializing
@@ -38,255 +113,1317 @@
 #define LED_MEASURING   0xFF00FF  // Magenta - Taking measurement
 #define LED_OFF         0x000000  // Off - Measurement complete
 
+// Task IDs, index into the task table
+enum TaskId : uint8_t {
+  TASK_ACQUISITION,
+  TASK_COMMAND,
+  TASK_OUTPUT,
+#if FEATURE_DECONTAMINATION
+  TASK_HEATER,
+#endif
+#if FEATURE_LED
+  TASK_LED,
+#endif
+#if FEATURE_WATCHDOG
+  TASK_WATCHDOG,
+#endif
+#if FEATURE_MULTI_SENSOR
+  TASK_TIMEBASE,
+#endif
+#if FEATURE_DIAGNOSTICS
+  TASK_NOISE,
+#endif
+  TASK_COUNT
+};
+
+enum DeviceMode : uint8_t {
+  MODE_IDLE,            // Waiting for commands, former setup() loop
+#if FEATURE_DECONTAMINATION
+  MODE_DECONTAMINATING, // Heater running
+#endif
+#if FEATURE_DIAGNOSTICS
+  MODE_CHARACTERISING,  // Allan deviation series running
+#endif
+  MODE_MEASURING        // Sampling on 'u'
+};
+
+// Measurement command and max conversion time (8.3 / 4.5 / 1.6 ms) per Precision,
+// rounded up to scheduler ticks for the wait and exact for the conversion window
+static_assert((int)PRECISION_HIGH == SHT4X_PRECISION_HIGH && (int)PRECISION_LOW == SHT4X_PRECISION_LOW,
+              "Precision indexes the SHT4x tables");
+#define SHT4X_PRECISION_TABLE(field) { \
+  Sht4xMeasurement<SHT4X_PRECISION_HIGH>::field, \
+  Sht4xMeasurement<SHT4X_PRECISION_MEDIUM>::field, \
+  Sht4xMeasurement<SHT4X_PRECISION_LOW>::field \
+}
+#define US_TO_MS_CEIL(us) (((us) + 999) / 1000)
+const uint8_t precisionCommands[] = SHT4X_PRECISION_TABLE(command);
+const uint16_t precisionConversionUs[] = SHT4X_PRECISION_TABLE(conversionUs);
+const uint8_t precisionConversionMs[] = {
+  US_TO_MS_CEIL(Sht4xMeasurement<SHT4X_PRECISION_HIGH>::conversionUs),
+  US_TO_MS_CEIL(Sht4xMeasurement<SHT4X_PRECISION_MEDIUM>::conversionUs),
+  US_TO_MS_CEIL(Sht4xMeasurement<SHT4X_PRECISION_LOW>::conversionUs)
+};
+
+// Measurement noise variance in ticks^2 per Precision, from the datasheet
+// repeatability (3 sigma) of 0.04 / 0.07 / 0.1 degC and 0.08 / 0.15 / 0.25 %RH
+const uint16_t precisionNoiseT[] = {25, 81, 156};
+const uint16_t precisionNoiseRh[] = {196, 676, 1936};
+
+extern Task tasks[TASK_COUNT];
+
+// Coroutine frames, statically allocated
+struct AcquisitionFrame {
+  Coroutine co;
+  Sample sample;
+  unsigned long nextSampleAt;  // Free-running mode
+  uint32_t periodMs;           // Current free-running period, varies in adaptive mode
+  bool havePrevious;           // Previous sample below is valid for the rate of change
+  Sample previous;
+  unsigned long windowStartMs; // Conversion window: first command to end of last conversion
+  uint32_t windowStartUs;
+  uint32_t lastStartUs;
+#if FEATURE_MULTI_SENSOR
+  SofStamp windowStartSof;
+#endif
+  uint8_t conversions;
+  uint32_t tSum, rhSum;        // FILTER_AVERAGE accumulators
+  uint16_t tTicks, rhTicks;
+};
+
+#if FEATURE_DECONTAMINATION
+struct HeaterFrame {
+  Coroutine co;
+  unsigned int cycleCount;
+  unsigned long pollUntil;
+  uint16_t tTicks, rhTicks;
+};
+#endif
+
+#if FEATURE_DIAGNOSTICS
+struct NoiseFrame {
+  Coroutine co;
+  uint8_t precision;
+  uint32_t tau0Ms;             // Sample spacing
+  uint16_t samples;            // Series length for this precision
+  unsigned long nextSampleAt;
+  uint16_t tTicks, rhTicks;
+};
+#endif
+
 // Global objects
-Adafruit_SHT4x sht4 = Adafruit_SHT4x();
+#if FEATURE_LED
 Adafruit_NeoPixel pixel(1, PIN_NEOPIXEL, NEO_GRB + NEO_KHZ800);
+#endif
+SampleQueue<Sample, SAMPLE_BUFFER_SIZE> samples;
 
 // Global variables
 uint32_t sht4SerialNumber;        // Sensor serial number
 unsigned long startMeasurementTime; // Start time of measurement mode
+uint32_t sampleSequence = 0;      // Samples produced since 's', continued after a watchdog reset
+DeviceConfig config;              // Live settings, persisted with 'w'
+DeviceMode mode = MODE_IDLE;
+bool hostConnected = false;       // USB host has the port open
+
+// Acquisition state
+AcquisitionFrame acquisition;
+// 'u' and '*' not yet served, each with its trigger latency or SAMPLE_NOT_TRIGGERED,
+// beyond REQUEST_QUEUE_LENGTH the oldest are dropped. Under schedulerLock()
+RingBuffer<uint16_t, REQUEST_QUEUE_LENGTH> requests;
+bool acquisitionParked = false;   // Found no request and awaits a signal, under schedulerLock()
+uint8_t acquisitionErrors = 0;    // Failed reads not yet reported by the output task
+uint32_t reportedPeriodMs;        // Adaptive period last announced by the output task
+KalmanChannel kalmanT, kalmanRh;  // FILTER_KALMAN state, owned by the acquisition task
+
+uint8_t acquisitionFailures = 0;  // Consecutive failed samples, stop the heartbeat at ACQUISITION_MAX_FAILURES
+
+#if FEATURE_WATCHDOG
+// Supervisor state
+int watchdogTimeoutMs;            // Actual hardware timeout, 0 until enabled
+bool watchdogStarving = false;    // A heartbeat is overdue, reset pending unless it recovers
+bool resumedAfterReset = false;   // State restored from `retained`, reported in the banner
+#endif
+
+#if FEATURE_MULTI_SENSOR
+// Broadcast trigger state, capture time is latched by the command task
+bool triggerArmed = false;        // '*' accepted, set with 'k1'
+uint32_t lastIdlePollUs;          // Last command poll that found no RX data
+#endif
+
+#if FEATURE_DIAGNOSTICS
+// Noise characterisation state
+NoiseFrame noise;
+AllanBuffer allanBuffer;
+uint32_t allanSeconds;            // Series duration per precision
+#endif
+
+#if FEATURE_DECONTAMINATION
+// Decontamination state
+HeaterFrame heater;
+unsigned long decontaminationUntil;
+#endif
+
+// Command parser state, for commands followed by a number
+char pendingCommand = 0;
+long pendingArgument;
+unsigned long pendingSince;
+
+#if FEATURE_LED
+// LED state
+uint32_t ledColor = LED_INIT;
+bool ledFlash = false;
+#endif
+
+// Datasheet conversions, RH is clamped to 0-100 %
+float ticksToTemperature(uint16_t tTicks) {
+  return -45 + 175 * (float)tTicks / 65535;
+}
+
+float ticksToHumidity(uint16_t rhTicks) {
+  return constrain(-6 + 125 * (float)rhTicks / 65535, 0.0f, 100.0f);
+}
 
 /**
- * Handle sensor decontamination heating process
- * Reads optional time parameter from serial, defaults to 30 minutes
+ * Change the LED colour, applied by the LED task
+ * A flash returns to off after LED_FLASH_MS
  */
-void handleDecontamination() {
-  delay(1000);  // Brief delay to ensure serial buffer is ready
+void setLed(uint32_t color, bool flash = false) {
+#if FEATURE_LED
+  ledColor = color;
+  ledFlash = flash;
+  schedulerWake(TASK_LED);
+#endif
+}
 
-  // Read decontamination interval from serial input
-  unsigned long decontaminationUntil = 0;
-  int decontaminationInterval = Serial.parseInt();
-  
-  if (decontaminationInterval == 0) {
-    decontaminationInterval = DEFAULT_DECONTAMINATION_MS;
-    Serial.println("# Invalid decontamination interval, using default (30 min)...");
+/**
+ * Claim the oldest pending request and its trigger latency, shared with the
+ * command task
+ * Without one the task parks in the same critical section, so a request
+ * queued before it reaches CO_AWAIT_SIGNAL still wakes it
+ */
+bool takeRequest(uint16_t *triggerLatencyUs) {
+  schedulerLock();
+  bool available = requests.pop(triggerLatencyUs);
+  if (!available) {
+    acquisitionParked = true;
   }
+  schedulerUnlock();
+  return available;
+}
 
-  // Start decontamination process
-  Serial.print("# Starting ");
-  Serial.print(decontaminationInterval);
-  Serial.println(" ms decontamination heater...");
+/**
+ * Take the acquisition task off the parked list, call under schedulerLock()
+ * Returns true if the caller has to wake it, a busy task picks up new work
+ * when its conversion ends
+ */
+bool unparkAcquisition() {
+  bool parked = acquisitionParked;
+  acquisitionParked = false;
+  return parked;
+}
 
-  decontaminationUntil = ((unsigned long) decontaminationInterval) + millis();
-  sht4.setHeater(SHT4X_HIGH_HEATER_1S);
-  
-  // Set LED to green (decontamination mode)
-  pixel.setPixelColor(0, LED_DECONTAM);
-  pixel.show();
-  
-  // Monitor decontamination process
-  sensors_event_t humidity, temp;
-  unsigned int cycleCount = 0;
-
-  while (millis() < decontaminationUntil) {
-    if (cycleCount % DECONTAM_SKIPS != 0) {
-      // Raw I2C heating cycle - skip read and delay only until ACk
-      Wire.beginTransmission(SHT4x_DEFAULT_ADDR);
-      Wire.write(SHT4x_HIGHHEAT_1S); // 0x39
-      Wire.endTransmission();
-      
-      // The datasheet specifies 1.10s max measurement duration for 1s high heater.
-      // Wait roughly 1s then poll until sensor ACKs
-      delay(800);
-      
-      // Poll I2C address for ACK indicating completion
-      while (true) {
-        Wire.requestFrom(SHT4x_DEFAULT_ADDR, 6);
-        if (Wire.available()) {
-          break;
-        }
-        delay(1);
+/**
+ * Queue a sample request from the command task, triggerLatencyUs stays
+ * with it up to the sample
+ */
+void queueRequest(uint16_t triggerLatencyUs) {
+  schedulerLock();
+  requests.push(triggerLatencyUs);
+  bool wake = unparkAcquisition();
+  schedulerUnlock();
+  if (wake) {
+    schedulerWake(TASK_ACQUISITION);  // Otherwise served when the conversion ends
+  }
+}
+
+/**
+ * Conversions averaged into one reported sample
+ */
+uint8_t conversionsPerSample() {
+  return config.filter == FILTER_AVERAGE && config.filterLength > 1 ? config.filterLength : 1;
+}
+
+bool freeRunning() {
+  return mode == MODE_MEASURING && config.periodMs > 0;
+}
+
+/**
+ * FILTER_KALMAN - smooth the sample in place
+ * With process noise r / n^2 the steady-state gain is about 1 / n, so the
+ * filter remembers roughly filterLength samples
+ */
+void kalmanFilterSample(Sample *sample) {
+  uint32_t n = config.filterLength > 0 ? config.filterLength : 1;
+  uint32_t rT = (uint32_t)precisionNoiseT[config.precision] << KALMAN_FRACTION_BITS;
+  uint32_t rRh = (uint32_t)precisionNoiseRh[config.precision] << KALMAN_FRACTION_BITS;
+  uint32_t qT = rT / (n * n) + 1;
+  uint32_t qRh = rRh / (n * n) + 1;
+  schedulerLock();
+  sample->tTicks = kalmanUpdate(&kalmanT, sample->tTicks, qT, rT);
+  sample->rhTicks = kalmanUpdate(&kalmanRh, sample->rhTicks, qRh, rRh);
+  schedulerUnlock();
+}
+
+/**
+ * Print the Kalman innovation statistics since measurement start
+ */
+void printFilterStats() {
+  schedulerLock();
+  KalmanChannel t = kalmanT;
+  KalmanChannel rh = kalmanRh;
+  schedulerUnlock();
+  kalmanPrintStats(Serial, "T", t);
+  kalmanPrintStats(Serial, "RH", rh);
+}
+
+/**
+ * Adaptive sampling - halve the free-running period while T or RH change
+ * faster than adaptiveThreshold ticks/s, stretch it by a quarter once the
+ * rate drops below half the threshold, within [minPeriodMs, periodMs]
+ */
+void adaptPeriod(AcquisitionFrame &f) {
+  uint32_t period = f.periodMs;
+  if (freeRunning() && config.adaptiveThreshold > 0 && f.havePrevious) {
+    uint32_t dt = f.sample.timestamp - f.previous.timestamp;
+    uint32_t dT = abs((int32_t)f.sample.tTicks - (int32_t)f.previous.tTicks);
+    uint32_t dRh = abs((int32_t)f.sample.rhTicks - (int32_t)f.previous.rhTicks);
+    uint32_t rate = (dT > dRh ? dT : dRh) * 1000UL / (dt > 0 ? dt : 1);
+    uint32_t minPeriod = min(config.minPeriodMs, config.periodMs);
+
+    if (rate > config.adaptiveThreshold) {
+      period = max(period / 2, minPeriod);
+    } else if (rate < config.adaptiveThreshold / 2U) {
+      period = min(period + period / 4 + 1, config.periodMs);
+    }
+  }
+  // Move the already scheduled next sample along with the period
+  f.nextSampleAt = f.nextSampleAt - f.periodMs + period;
+  f.periodMs = period;
+  f.sample.periodMs = period;
+  f.previous = f.sample;
+  f.havePrevious = true;
+}
+
+/**
+ * Acquisition sequence - sample on 'u' requests, or on the configured
+ * period in free-running mode
+ */
+CoStatus acquisitionSequence() {
+  AcquisitionFrame &f = acquisition;
+  CO_BEGIN(f.co);
+  for (;;) {
+    f.sample.triggerLatencyUs = SAMPLE_NOT_TRIGGERED;
+    if (freeRunning()) {
+      while ((long)(millis() - f.nextSampleAt) < 0) {
+        CO_AWAIT_MS(f.co, f.nextSampleAt - millis());
       }
-    } else {
-      // Perform full I2C read cycle every DECONTAM_SKIPS loops
-      Wire.beginTransmission(SHT4x_DEFAULT_ADDR);
-      Wire.write(SHT4x_HIGHHEAT_1S); // 0x39
-      Wire.endTransmission();
-      
-      // The datasheet specifies 1.10s max measurement duration for 1s high heater.
-      // Wait roughly 1s then poll until sensor ACKs
-      delay(800);
-      
-      unsigned long wait_until = millis() + 1000; // Wait up to 5 seconds for ACK
-      while (true) {
-        Wire.requestFrom(SHT4x_DEFAULT_ADDR, 6);
-        if (Wire.available()) {
-          break; // ACK received, heating & measurement complete
-        }
-        if (millis() > wait_until) {
-          pixel.setPixelColor(0, LED_ERROR);
-          pixel.show();
-          Serial.println("Error reading from sensor, abort...");
-          return; // Exit decontamination on error
-        }
-        delay(1);
+      if (!freeRunning()) {
+        continue;  // Stopped while waiting
+      }
+      f.nextSampleAt += f.periodMs;
+      if ((long)(millis() - f.nextSampleAt) >= 0) {
+        f.nextSampleAt = millis() + f.periodMs;  // Fell behind, skip missed periods
+      }
+    } else if (!takeRequest(&f.sample.triggerLatencyUs)) {
+      CO_AWAIT_SIGNAL(f.co);
+      continue;
+    }
+
+    f.tSum = 0;
+    f.rhSum = 0;
+    for (f.conversions = 0; f.conversions < conversionsPerSample(); f.conversions++) {
+      if (!sht4xSendCommand(precisionCommands[config.precision])) {
+        break;
       }
+      // The sensor samples from the end of the command write until the
+      // conversion finishes, independent of when the result is read
+      f.lastStartUs = micros();
+      if (f.conversions == 0) {
+        f.windowStartUs = f.lastStartUs;
+        f.windowStartMs = millis();
+#if FEATURE_MULTI_SENSOR
+        f.windowStartSof = usbTimebaseLatch();
+#endif
+      }
+      CO_AWAIT_MS(f.co, precisionConversionMs[config.precision]);
+      if (!sht4xReadTicks(&f.tTicks, &f.rhTicks)) {
+        break;
+      }
+      f.tSum += f.tTicks;
+      f.rhSum += f.rhTicks;
+    }
 
-      uint8_t readbuffer[6];
-      for (int i = 0; i < 6; i++) {
-        readbuffer[i] = Wire.read();
+    if (f.conversions > 0 && f.conversions == conversionsPerSample()) {
+      // Timestamps refer to the midpoint of the conversion window, so they
+      // do not depend on precision, averaging or I2C and scheduling delays
+      uint32_t windowUs = f.lastStartUs - f.windowStartUs + precisionConversionUs[config.precision];
+      f.sample.conversionUs = windowUs < 0xFFFF ? windowUs : 0xFFFF;
+      f.sample.timestamp = f.windowStartMs - startMeasurementTime + (windowUs / 2 + 500) / 1000;
+#if FEATURE_MULTI_SENSOR
+      SofStamp sof = sofAdvance(f.windowStartSof, windowUs / 2);
+      f.sample.sofFrame = sof.frame;
+      f.sample.sofOffsetUs = sof.offsetUs;
+#else
+      f.sample.sofFrame = SOF_INVALID;
+      f.sample.sofOffsetUs = 0;
+#endif
+      f.sample.tTicks = (f.tSum + f.conversions / 2) / f.conversions;
+      f.sample.rhTicks = (f.rhSum + f.conversions / 2) / f.conversions;
+      if (config.filter == FILTER_KALMAN) {
+        kalmanFilterSample(&f.sample);
       }
+      adaptPeriod(f);
+      f.sample.sequence = sampleSequence++;
+      samples.push(f.sample);
+      clockSampleDone();
+      bootMark(BOOT_FIRST_SAMPLE);
+      schedulerWake(TASK_OUTPUT);
+      acquisitionFailures = 0;
+      continue;
+    }
+
+    // Error reading sensor - reported by the output task
+    schedulerLock();
+    acquisitionErrors++;
+    if (acquisitionFailures < 255) {
+      acquisitionFailures++;
+    }
+    schedulerUnlock();
+    schedulerWake(TASK_OUTPUT);
+  }
+  CO_END(f.co);
+}
+
+void acquisitionTask() {
+  coroutineStep(acquisition.co, acquisitionSequence, TASK_ACQUISITION);
+  // A timed wait must resume within its delay plus a margin, a wait for 'u'
+  // is healthy however long the host stays silent. A sensor that keeps
+  // failing leaves the last deadline to expire
+  if (acquisitionFailures >= ACQUISITION_MAX_FAILURES) {
+    return;
+  }
+  if (coroutineAwaitingSignal(acquisition.co)) {
+    heartbeatIdle(TASK_ACQUISITION);
+  } else {
+    heartbeat(TASK_ACQUISITION, acquisition.co.waitMs + HEARTBEAT_MARGIN_MS);
+  }
+}
 
+/**
+ * Map a requested OutputFormat to one compiled into this image
+ */
+uint8_t supportedFormat(long format) {
+#if FEATURE_CSV && FEATURE_BINARY
+  return format == FORMAT_BINARY ? FORMAT_BINARY : FORMAT_CSV;
+#elif FEATURE_BINARY
+  return FORMAT_BINARY;
+#else
+  return FORMAT_CSV;
+#endif
+}
+
+/**
+ * Write one sample in the selected output format
+ * CSV format: serial_number, timestamp, temperature, humidity, sequence
+ */
+void writeSample(Print &out, const Sample &sample, uint8_t format) {
+#if FEATURE_BINARY
+  if (format == FORMAT_BINARY) {
+    // Binary mode sends raw ticks and leaves the conversion to the host
+    writeRawSampleFrame(out, sht4SerialNumber, sample.timestamp,
+                        sample.tTicks, sample.rhTicks,
+                        sample.sofFrame, sample.sofOffsetUs, sample.conversionUs,
+                        sample.sequence);
+    return;
+  }
+#endif
+#if FEATURE_CSV
+  out.print("0x");
+  out.print(sht4SerialNumber, HEX);
+  out.print(", ");
+  out.print(sample.timestamp);
+  out.print(", ");
+  out.print(ticksToTemperature(sample.tTicks));
+  out.print(", ");
+  out.print(ticksToHumidity(sample.rhTicks));
+  out.print(", ");
+  out.println(sample.sequence);
+#endif
+}
 
-      float t_ticks = (uint16_t)readbuffer[0] * 256 + (uint16_t)readbuffer[1];
-      float rh_ticks = (uint16_t)readbuffer[3] * 256 + (uint16_t)readbuffer[4];
+/**
+ * Output task - drain the sample buffer as CSV lines or binary frames
+ */
+void outputTask() {
+  if (!hostConnected) {
+    return;  // Keep samples buffered until a host opens the port
+  }
+  clockBurst();  // Formatting and encoding are the CPU-heavy part
+
+  bool wroteSample = false;
+  Sample sample;
+  while (samples.pop(&sample)) {
+    if (sample.triggerLatencyUs != SAMPLE_NOT_TRIGGERED) {
+      Serial.print("# Trigger latency: <= ");
+      Serial.print(sample.triggerLatencyUs);
+      Serial.println(" us");
+    }
+    writeSample(Serial, sample, config.format);
+    if (sample.periodMs != reportedPeriodMs) {
+      // Adaptive period change, applies from the next sample on
+      reportedPeriodMs = sample.periodMs;
+      Serial.print("# Period: ");
+      Serial.print(reportedPeriodMs);
+      Serial.println(" ms");
+    }
+    wroteSample = true;
+  }
+  if (wroteSample) {
+    // Successful measurement - flash magenta LED
+    setLed(LED_MEASURING, true);
+  }
+
+  schedulerLock();
+  uint8_t errors = acquisitionErrors;
+  acquisitionErrors = 0;
+  schedulerUnlock();
+  for (uint8_t i = 0; i < errors; i++) {
+    // Error reading sensor - indicate with yellow LED
+    setLed(LED_ERROR);
+    Serial.println("Error reading from sensor, retrying...");
+  }
+}
+
+#if FEATURE_LED
+/**
+ * LED task - the only place that touches the NeoPixel
+ */
+void ledTask() {
+  clockBurst();  // PIO bit timing was set up for the full clock
+  pixel.setPixelColor(0, ledColor);
+  pixel.show();
+  if (ledFlash) {
+    ledColor = LED_OFF;
+    ledFlash = false;
+    schedulerWake(TASK_LED, LED_FLASH_MS);
+  }
+}
+#endif
+
+#if FEATURE_WATCHDOG
+/**
+ * Watchdog task - the supervisor: feed the hardware watchdog while every
+ * supervised task is on time, independent of how often the host polls
+ * A missed heartbeat starves it and the board resets WATCHDOG_TIMEOUT_MS later
+ */
+void watchdogTask() {
+  uint8_t overdue = supervisorCheck();
+  if (overdue == SUPERVISOR_HEALTHY) {
+    watchdogFeed();
+    if (watchdogStarving) {
+      watchdogStarving = false;
+      Serial.println("# Watchdog: heartbeats back on time");
+    }
+  } else if (!watchdogStarving) {
+    watchdogStarving = true;
+    Serial.print("# Watchdog: ");
+    Serial.print(tasks[overdue].name);
+    Serial.println(" missed its heartbeat, resetting");
+  }
+}
+
+/**
+ * Watchdog early warning, interrupt context - half a timeout before the
+ * reset, save what is needed to carry on: measurement time, settings,
+ * sample numbering, the samples not yet sent and which task hung
+ */
+void saveStateBeforeReset() {
+  retained.elapsedMs = millis() - startMeasurementTime + watchdogTimeoutMs / 2;
+  retained.sequence = sampleSequence;
+  retained.config = config;
+  retained.mode = mode;
+#if FEATURE_MULTI_SENSOR
+  retained.triggerArmed = triggerArmed;
+#else
+  retained.triggerArmed = false;
+#endif
+  uint8_t overdue = supervisorCheckFromIsr();
+  retained.overdueTask = overdue == SUPERVISOR_HEALTHY ? SCHEDULER_NO_TASK : overdue;
+  retained.runningTask = schedulerRunningTask();
+  // Copies, the output task keeps sending in case the watchdog is fed in
+  // time. What it sends until the reset comes again after it, the host
+  // drops those by their sequence numbers
+  retained.sampleCount = samples.peekFromIsr(retained.samples, RETAINED_SAMPLES);
+  retainedCommit();
+}
+#endif
+
+#if FEATURE_MULTI_SENSOR
+/**
+ * Timebase task - periodically re-find the USB frame edge so sub-frame
+ * offsets stay within the drift of micros() over SOF_CALIBRATE_MS
+ */
+void timebaseTask() {
+  usbTimebaseCalibrate();
+}
+#endif
+
+#if FEATURE_DECONTAMINATION
+
+/**
+ * Finish decontamination and return to the ready state
+ */
+void stopDecontamination() {
+  Serial.println("# Decontamination complete");
+  Serial.println(SETUP_MSG);
+  setLed(LED_READY);
+  mode = MODE_IDLE;
+}
+
+/**
+ * Heater sequence - one 1 s high heat pulse per cycle, with a status read
+ * every DECONTAM_SKIPS cycles
+ */
+CoStatus heaterSequence() {
+  HeaterFrame &f = heater;
+  CO_BEGIN(f.co);
+  while ((long)(millis() - decontaminationUntil) < 0) {
+    heartbeat(TASK_HEATER, HEATER_HEARTBEAT_MS);
+    sht4xSendCommand(SHT4X_HEATER_HIGH_1S);
+
+    // The datasheet specifies 1.10s max measurement duration for 1s high heater.
+    // Wait roughly 1s then poll until sensor ACKs
+    CO_AWAIT_MS(f.co, HEATER_WAIT_MS);
+
+    f.pollUntil = millis() + HEATER_READ_TIMEOUT_MS;
+    while (!sht4xReadTicks(&f.tTicks, &f.rhTicks)) {
+      if ((long)(millis() - f.pollUntil) > 0) {
+        setLed(LED_ERROR);
+        Serial.println("Error reading from sensor, abort...");
+        mode = MODE_IDLE;
+        CO_EXIT(f.co); // Exit decontamination on error
+      }
+      CO_AWAIT_MS(f.co, 1);
+    }
+
+    if (f.cycleCount % DECONTAM_SKIPS == 0) {
       unsigned long countdown = decontaminationUntil - millis();
       Serial.print("Decontaminating: T=");
-      Serial.print(-45 + 175 * t_ticks / 65535);
+      Serial.print(ticksToTemperature(f.tTicks));
       Serial.print("°C, RH=");
-      Serial.print(-6 + 125 * rh_ticks / 65535);
+      Serial.print(ticksToHumidity(f.rhTicks));
       Serial.print("%, ");
       Serial.print(countdown);
       Serial.println(" ms left");
+    }
+    f.cycleCount++;
+  }
+  stopDecontamination();
+  CO_END(f.co);
+}
+
+void heaterTask() {
+  if (coroutineStep(heater.co, heaterSequence, TASK_HEATER) == CO_DONE) {
+    heartbeatIdle(TASK_HEATER);
+  }
+}
+
+/**
+ * Start sensor decontamination heating, defaults to 30 minutes
+ */
+void startDecontamination(long decontaminationInterval) {
+  if (decontaminationInterval <= 0) {
+    decontaminationInterval = DEFAULT_DECONTAMINATION_MS;
+    Serial.println("# Invalid decontamination interval, using default (30 min)...");
+  }
+
+  // Start decontamination process
+  Serial.print("# Starting ");
+  Serial.print(decontaminationInterval);
+  Serial.println(" ms decontamination heater...");
+
+  decontaminationUntil = ((unsigned long) decontaminationInterval) + millis();
+  coroutineReset(heater.co);
+  heater.cycleCount = 0;
+  mode = MODE_DECONTAMINATING;
+
+  // Set LED to green (decontamination mode)
+  setLed(LED_DECONTAM);
+  schedulerWake(TASK_HEATER);
+}
+#endif  // FEATURE_DECONTAMINATION
+
+#if FEATURE_DIAGNOSTICS
+
+/**
+ * Noise sequence - for each precision, sample at a fixed spacing tau0 and
+ * print the overlapping Allan deviation at octave-spaced tau
+ */
+CoStatus noiseSequence() {
+  NoiseFrame &f = noise;
+  CO_BEGIN(f.co);
+  for (f.precision = PRECISION_HIGH; f.precision <= PRECISION_LOW; f.precision++) {
+    // Spread the buffer over the requested duration, but never sample faster
+    // than one conversion plus a scheduler tick
+    f.tau0Ms = max(allanSeconds * 1000UL / ALLAN_MAX_SAMPLES,
+                   (unsigned long)precisionConversionMs[f.precision] + 1);
+    f.samples = min(allanSeconds * 1000UL / f.tau0Ms, (unsigned long)ALLAN_MAX_SAMPLES);
+    allanReset(&allanBuffer);
+    Serial.print("# Allan: precision ");
+    Serial.print(f.precision);
+    Serial.print(", tau0 ");
+    Serial.print(f.tau0Ms);
+    Serial.print(" ms, ");
+    Serial.print(f.samples);
+    Serial.println(" samples");
 
-      // if (!sht4.getEvent(&humidity, &temp)) {
-      //   // Error reading sensor - abort decontamination
-      //   pixel.setPixelColor(0, LED_ERROR);
-      //   pixel.show();
-      //   Serial.println("Error reading from sensor, abort...");
-      //   break;
-      // } 
-      
-      // // Display status using the freshly read data
-      // long countdown = decontaminationUntil - millis();
-      // Serial.print("Decontaminating: T=");
-      // Serial.print(temp.temperature);
-      // Serial.print("°C, RH=");
-      // Serial.print(humidity.relative_humidity);
-      // Serial.print("%, ");
-      // Serial.print(countdown);
-      // Serial.println(" ms left");
+    f.nextSampleAt = millis();
+    while (allanBuffer.count < f.samples) {
+      while ((long)(millis() - f.nextSampleAt) < 0) {
+        CO_AWAIT_MS(f.co, f.nextSampleAt - millis());
+      }
+      if (mode != MODE_CHARACTERISING) {
+        CO_EXIT(f.co);  // Aborted with 'x'
+      }
+      // A late sample keeps its slot, so the spacing stays tau0 on average
+      f.nextSampleAt += f.tau0Ms;
+      if (!sht4xSendCommand(precisionCommands[f.precision])) {
+        continue;
+      }
+      CO_AWAIT_MS(f.co, precisionConversionMs[f.precision]);
+      if (sht4xReadTicks(&f.tTicks, &f.rhTicks)) {
+        allanAdd(&allanBuffer, f.tTicks, f.rhTicks);
+      }
     }
-    cycleCount++;
+    allanPrint(Serial, allanBuffer, f.precision, f.tau0Ms);
   }
-  
-  // Decontamination complete - return to ready state
-  Serial.println("# Decontamination complete");
+  Serial.println("# Allan deviation complete");
   Serial.println(SETUP_MSG);
-  pixel.setPixelColor(0, LED_READY);
-  pixel.show();
-  sht4.setHeater(SHT4X_NO_HEATER);
+  setLed(LED_READY);
+  mode = MODE_IDLE;
+  CO_END(f.co);
+}
+
+void noiseTask() {
+  if (coroutineStep(noise.co, noiseSequence, TASK_NOISE) == CO_DONE) {
+    heartbeatIdle(TASK_NOISE);
+  } else {
+    heartbeat(TASK_NOISE, noise.co.waitMs + HEARTBEAT_MARGIN_MS);
+  }
 }
 
 /**
- * Setup function - Initialize hardware and wait for user commands
+ * Start the Allan deviation series, seconds per precision
  */
-void setup() {
-  // Initialize NeoPixel and set to blue (initializing)
-  pixel.begin();
-  pixel.setPixelColor(0, LED_INIT);
-  pixel.show();
-  
-  // Initialize serial communication at 115200 baud
-  Serial.begin(115200);
-  while (!Serial) {
-    delay(10);     // Wait for serial console to open (Zero, Leonardo, etc.)
+void startCharacterisation(long seconds) {
+  allanSeconds = seconds > 0 ? min(seconds, (long)ALLAN_MAX_S) : ALLAN_DEFAULT_S;
+  Serial.print("# Measuring noise for ");
+  Serial.print(allanSeconds);
+  Serial.println(" s per precision, 'x' aborts");
+  coroutineReset(noise.co);
+  mode = MODE_CHARACTERISING;
+  setLed(LED_MEASURING);
+  schedulerWake(TASK_NOISE);
+}
+
+// Benchmark inputs, volatile so the compiler cannot fold the work away
+volatile uint16_t benchTicks = 26214;
+volatile float benchResult;
+NullPrint benchSink;
+Sample benchSample = {1234567, 26214, 30000, 0, 0, 8300, 0, SAMPLE_NOT_TRIGGERED, 123456};
+KalmanChannel benchKalman;
+RingBuffer<Sample, 4> benchRing;
+#if defined(BENCH_ADAFRUIT_SHT4X)
+Adafruit_SHT4x benchSht4;
+#endif
+
+/**
+ * Between benchmark stages, each well within the watchdog early warning:
+ * report progress and feed the watchdog for the tasks held up meanwhile
+ */
+void benchmarkKeepAlive() {
+  heartbeat(TASK_COMMAND, COMMAND_HEARTBEAT_MS);
+#if FEATURE_WATCHDOG
+  watchdogFeed();
+#endif
+}
+
+/**
+ * Time the per-sample hot path: sensor I/O, CRC, conversion, formatting
+ * and filtering, in ns per operation. Blocks the scheduler for about 1 s,
+ * the supervised deadlines move on by as much
+ */
+void printBenchmark() {
+  uint32_t benchStart = millis();
+  clockBurst();
+  Serial.println("# bench, operation, ns per op");
+
+  // I2C transactions only, the conversion wait in between is not counted
+  uint32_t busUs = 0;
+  uint8_t reads = 0;
+  for (uint8_t i = 0; i < 20; i++) {
+    uint16_t tTicks, rhTicks;
+    uint32_t start = micros();
+    bool sent = sht4xSendCommand(precisionCommands[PRECISION_LOW]);
+    busUs += micros() - start;
+    delay(precisionConversionMs[PRECISION_LOW]);
+    start = micros();
+    if (sent && sht4xReadTicks(&tTicks, &rhTicks)) {
+      reads++;
+    }
+    busUs += micros() - start;
   }
+  benchmarkPrintResult(Serial, "i2c_sample", busUs, reads > 0 ? reads : 1);
+  benchmarkKeepAlive();
 
-  // Initialize and verify SHT4x sensor
-  Serial.println("# Adafruit SHT41");
-  if (!sht4.begin()) {
-    Serial.println("# Couldn't find SHT4x");
-    while (1) delay(1);  // Halt execution if sensor not found
+  // Whole blocking low-precision sample including the conversion wait, the
+  // same work as the Adafruit_SHT4x::getEvent() reference below
+  benchmarkRun(Serial, "sht4x_measure", []() {
+    uint16_t tTicks, rhTicks;
+    benchResult = sht4xMeasure<SHT4X_PRECISION_LOW>(&tTicks, &rhTicks);
+  }, 20);
+  benchmarkKeepAlive();
+#if defined(BENCH_ADAFRUIT_SHT4X)
+  benchSht4.begin();
+  benchSht4.setPrecision(SHT4X_LOW_PRECISION);
+  benchmarkRun(Serial, "get_event", []() {
+    sensors_event_t humidity, temperature;
+    benchSht4.getEvent(&humidity, &temperature);
+    benchResult = temperature.temperature;
+  }, 20);
+  benchmarkKeepAlive();
+#endif
+
+  benchmarkRun(Serial, "crc8", []() {
+    uint8_t data[2] = {(uint8_t)(benchTicks >> 8), (uint8_t)benchTicks};
+    benchResult = crc8(data, 2);
+  }, 1000);
+  benchmarkKeepAlive();
+  benchmarkRun(Serial, "convert", []() {
+    benchResult = ticksToTemperature(benchTicks) + ticksToHumidity(benchTicks);
+  }, 1000);
+  benchmarkKeepAlive();
+#if FEATURE_CSV
+  benchmarkRun(Serial, "csv_line", []() {
+    writeSample(benchSink, benchSample, FORMAT_CSV);
+  }, 200);
+  benchmarkKeepAlive();
+#endif
+#if FEATURE_BINARY
+  benchmarkRun(Serial, "binary_frame", []() {
+    writeSample(benchSink, benchSample, FORMAT_BINARY);
+  }, 1000);
+  benchmarkKeepAlive();
+#endif
+  benchmarkRun(Serial, "kalman", []() {
+    benchResult = kalmanUpdate(&benchKalman, benchTicks, 100, 6400);
+  }, 1000);
+  benchmarkKeepAlive();
+  benchmarkRun(Serial, "ring_push_pop", []() {
+    Sample popped;
+    benchRing.push(benchSample);
+    benchRing.pop(&popped);
+  }, 1000);
+  benchmarkKeepAlive();
+#if ISR_LATENCY_PROBE
+  // Timer interrupt entry with the handler evicted from the XIP cache
+  IsrLatencyStats cold;
+  isrLatencyCold(200, &cold);
+  benchmarkPrintResult(Serial, "isr_latency_cold", cold.totalUs, cold.count > 0 ? cold.count : 1);
+  benchmarkPrintResult(Serial, "isr_latency_cold_max", cold.maxUs, 1);
+  benchmarkKeepAlive();
+#endif
+  supervisorPostpone(millis() - benchStart);
+  Serial.println("# bench done");
+}
+#endif  // FEATURE_DIAGNOSTICS
+
+/**
+ * Print CSV header for data logging
+ */
+void printCsvHeader() {
+  Serial.println("#=========================#");
+  Serial.println("# sht4SerialNumber, timestamp, temperature (degrees C), humidity (% rH), sequence");
+}
+
+/**
+ * Start measurement mode, elapsedMs > 0 continues an earlier measurement
+ */
+void startMeasurement(uint32_t elapsedMs = 0) {
+  startMeasurementTime = millis() - elapsedMs;
+  sampleSequence = 0;
+  clockResetStats();
+  mode = MODE_MEASURING;
+  printCsvHeader();
+
+  acquisition.periodMs = config.periodMs;
+  acquisition.havePrevious = false;
+  reportedPeriodMs = config.periodMs;
+  schedulerLock();
+  kalmanReset(&kalmanT);
+  kalmanReset(&kalmanRh);
+  schedulerUnlock();
+  if (config.periodMs > 0) {
+    acquisition.nextSampleAt = startMeasurementTime;
+    schedulerLock();
+    bool wake = unparkAcquisition();
+    schedulerUnlock();
+    if (wake) {
+      schedulerWake(TASK_ACQUISITION);
+    }
   }
-  
-  // Read and display sensor serial number
+}
+
+/**
+ * Leave measurement mode, e.g. to change the configuration of an
+ * autostarted board
+ */
+void stopMeasurement() {
+  mode = MODE_IDLE;
+  schedulerLock();
+  requests.clear();
+  schedulerUnlock();
+#if FEATURE_MULTI_SENSOR
+  triggerArmed = false;
+#endif
+  Serial.println("# Measurement stopped");
+  Serial.println(SETUP_MSG);
+  setLed(LED_READY);
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+#define CAPS_BOARD "rp2040"
+#define CAPS_CLOCK "xosc12m"    // Timestamps from the 12 MHz crystal
+#else
+#define CAPS_BOARD "samd21"
+#define CAPS_CLOCK "dfll48m"    // Crystalless, DFLL locked to USB start-of-frame
+#endif
+
+#if FEATURE_CSV && FEATURE_BINARY
+#define CAPS_FORMATS "csv,bin"
+#elif FEATURE_BINARY
+#define CAPS_FORMATS "bin"
+#else
+#define CAPS_FORMATS "csv"
+#endif
+
+#if FEATURE_MULTI_SENSOR
+#define CAPS_SYNC "sof=1 trig=1"
+#else
+#define CAPS_SYNC "sof=0 trig=0"
+#endif
+
+/**
+ * Print the capability descriptor, one line of space-separated key=value
+ * tokens so hosts can pick the fastest path this firmware supports
+ */
+void printCapabilities() {
+  Serial.print("caps: fw=" FIRMWARE_VERSION " proto=");
+  Serial.print(PROTOCOL_VERSION);
+  Serial.print(" fmt=" CAPS_FORMATS " board=" CAPS_BOARD " sensors=sht4x:0x");
+  Serial.print(sht4SerialNumber, HEX);
+  Serial.print(" maxrate=");
+  Serial.print(1000 / precisionConversionMs[PRECISION_LOW]);  // Hz, one low-precision conversion per sample
+  Serial.print(" maxperiod=");
+  Serial.print(MAX_PERIOD_MS);
+  Serial.print(" buf=");
+  Serial.print(SAMPLE_BUFFER_SIZE);
+  Serial.print(" frame=");
+  Serial.print(FRAME_MAX_PAYLOAD);
+  Serial.println(" clock=" CAPS_CLOCK " ts=ms " CAPS_SYNC " filters=avg,kalman");
+}
+
+/**
+ * Print the sensor banner, sent whenever a host opens the port
+ */
+void printBanner() {
+  Serial.println("# Adafruit SHT41");
   Serial.println("# Found SHT4x sensor");
   Serial.print("# Serial number: 0x");
-  sht4SerialNumber = sht4.readSerial();
   Serial.println(sht4SerialNumber, HEX);
+  configPrint(Serial, config);
+  bootPrintProfile(Serial);
+#if FEATURE_WATCHDOG
+  Serial.print("# Watchdog: ");
+  Serial.print(watchdogTimeoutMs);
+  Serial.println(" ms, fed while all task heartbeats are on time");
+  if (resumedAfterReset) {
+    resumedAfterReset = false;
+    Serial.print("# Resumed after watchdog reset: ");
+    Serial.print(retained.overdueTask < TASK_COUNT ? tasks[retained.overdueTask].name : "-");
+    Serial.print(" overdue, ");
+    Serial.print(retained.runningTask < TASK_COUNT ? tasks[retained.runningTask].name : "-");
+    Serial.print(" running, ");
+    Serial.print(retained.sampleCount);
+    Serial.print(" samples restored, sequence ");
+    Serial.println(retained.sequence);
+  }
+#endif
 
-  // Display available commands
-  Serial.println(SETUP_MSG);
+  if (mode == MODE_MEASURING) {
+    printCsvHeader();
+  } else {
+    // Display available commands
+    Serial.println(SETUP_MSG);
+    Serial.println(CONFIG_MSG);
+  }
+}
 
-  // Set LED to gray (ready state)
-  pixel.setPixelColor(0, LED_READY);
-  pixel.show();
-  
-  // Command processing loop - wait for user input
-  while (1) {
-    if (!Serial.available()) {
-      delay(10);
-      continue;
+/**
+ * Whether a USB host has the serial port open
+ */
+bool usbHostConnected() {
+#if defined(ARDUINO_ARCH_SAMD)
+  return Serial.dtr();  // operator bool() adds a 10 ms delay on this core
+#else
+  return (bool)Serial;
+#endif
+}
+
+/**
+ * Whether the host has enumerated the device and selected its configuration
+ */
+bool usbConfigured() {
+#if defined(ARDUINO_ARCH_SAMD)
+  return USBDevice.configured();
+#else
+  return tud_mounted();
+#endif
+}
+
+/**
+ * Commands that take a numeric argument, e.g. "h60000" or "f1"
+ */
+bool commandTakesArgument(char input) {
+  return input == 'h' || input == 'f' || input == 'a' || input == 'r' || input == 'p' ||
+         input == 'm' || input == 'k' || input == 'e' || input == 'l' || input == 'q' ||
+         input == 'v';
+}
+
+#if FEATURE_MULTI_SENSOR
+/**
+ * Start a sample for a broadcast trigger, the conversion begins as soon as
+ * the acquisition task runs
+ * The byte arrived at some point after the last empty RX poll, so the time
+ * since that poll bounds the receipt latency
+ */
+void latchTrigger() {
+  uint32_t latencyUs = micros() - lastIdlePollUs;
+  queueRequest(latencyUs < SAMPLE_NOT_TRIGGERED ? latencyUs : SAMPLE_NOT_TRIGGERED - 1);
+}
+#endif
+
+/**
+ * Execute one command for the current mode
+ */
+void dispatchCommand(char input, long argument) {
+  if (input == '\r' || input == '\n' || input == ' ') {
+    // Ignore line endings sent after numeric arguments
+    return;
+  }
+  if (input == 't') {
+    // Task statistics, available in every mode
+    schedulerPrintStats(Serial);
+    clockPrintStats(Serial);
+    isrLatencyPrint(Serial);
+    return;
+  }
+  if (input == 'i') {
+    // Filter innovation statistics, available in every mode
+    printFilterStats();
+    return;
+  }
+  if (input == 'c') {
+    // Capability descriptor, available in every mode
+    printCapabilities();
+    return;
+  }
+  if (input == 'n') {
+    // Display sensor serial number, available in every mode
+    Serial.print("0x");
+    Serial.println(sht4SerialNumber, HEX);
+    return;
+  }
+
+  if (mode == MODE_MEASURING) {
+    // Take measurement on 'u' command, free-running mode samples on its own
+    if (input == 'u' && !freeRunning()) {
+      queueRequest(SAMPLE_NOT_TRIGGERED);
+#if FEATURE_MULTI_SENSOR
+    } else if (input == TRIGGER_COMMAND && triggerArmed && !freeRunning()) {
+      latchTrigger();
+    } else if (input == 'k') {
+      // Pre-arm for broadcast triggers, the sensor stays idle until '*'
+      triggerArmed = argument != 0;
+      Serial.println(triggerArmed ? "# Trigger armed" : "# Trigger disarmed");
+#endif
+    } else if (input == 'x') {
+      stopMeasurement();
     }
-    
-    char input = Serial.read();
-    
-    if (input == 'n') {
-      // Display sensor serial number
-      Serial.print("0x");
-      Serial.println(sht4SerialNumber, HEX);
-      
-    } else if (input == 's') {
-      // Start measurement mode with watchdog enabled
-      int countdownMS = Watchdog.enable(WATCHDOG_TIMEOUT_MS);
-      Serial.print("Enabled the watchdog with max countdown of ");
-      Serial.print(countdownMS);
-      Serial.println(" milliseconds!");
-      startMeasurementTime = millis();
-      break;  // Exit command loop and proceed to measurement mode
-      
-    } else if (input == 'h') {
-      // Sensor decontamination mode
-      handleDecontamination();
-      
-    } else {
-      // Unknown command - display help
+    // Note: Other commands are ignored in measurement mode
+    return;
+  }
+#if FEATURE_DECONTAMINATION
+  if (mode == MODE_DECONTAMINATING) {
+    return;
+  }
+#endif
+#if FEATURE_DIAGNOSTICS
+  if (mode == MODE_CHARACTERISING) {
+    if (input == 'x') {
+      mode = MODE_IDLE;  // The noise sequence exits at its next sample
+      Serial.println("# Allan deviation aborted");
       Serial.println(SETUP_MSG);
+      setLed(LED_READY);
     }
+    return;
   }
+#endif
 
-  // Configure sensor for high precision measurements
-  sht4.setPrecision(SHT4X_HIGH_PRECISION);
-  sht4.setHeater(SHT4X_NO_HEATER);
+  if (input == 's') {
+    startMeasurement();
 
-  // Print CSV header for data logging
-  Serial.println("#=========================#");
-  Serial.println("# sht4SerialNumber, timestamp, temperature (degrees C), humidity (% rH)");
+#if FEATURE_DIAGNOSTICS
+  } else if (input == 'b') {
+    printBenchmark();
+
+  } else if (input == 'v') {
+    // Noise characterisation, Allan deviation per precision
+    startCharacterisation(argument);
+#endif
+
+#if FEATURE_DECONTAMINATION
+  } else if (input == 'h') {
+    // Sensor decontamination mode
+    startDecontamination(argument);
+#endif
+
+  } else if (input == 'f') {
+    // Select output format: 0 = CSV, 1 = binary raw-tick frames
+    config.format = supportedFormat(argument);
+    Serial.print("# Output format: ");
+    Serial.println(config.format == FORMAT_BINARY ? "binary" : "csv");
+
+  } else if (input == 'a') {
+    config.autostart = argument != 0;
+    configPrint(Serial, config);
+
+  } else if (input == 'r') {
+    config.periodMs = constrain(argument, 0L, (long)MAX_PERIOD_MS);
+    configPrint(Serial, config);
+
+  } else if (input == 'p') {
+    config.precision = constrain(argument, (long)PRECISION_HIGH, (long)PRECISION_LOW);
+    configPrint(Serial, config);
+
+  } else if (input == 'm') {
+    config.filterLength = constrain(argument, 1L, 255L);
+    config.filter = config.filterLength > 1 ? FILTER_AVERAGE : FILTER_NONE;
+    configPrint(Serial, config);
+
+  } else if (input == 'q') {
+    // Kalman smoothing over successive samples, pairs well with low precision
+    config.filterLength = constrain(argument, 1L, 255L);
+    config.filter = argument > 0 ? FILTER_KALMAN : FILTER_NONE;
+    configPrint(Serial, config);
+
+  } else if (input == 'e') {
+    config.adaptiveThreshold = constrain(argument, 0L, 65535L);
+    configPrint(Serial, config);
+
+  } else if (input == 'l') {
+    config.minPeriodMs = constrain(argument, 1L, (long)MAX_PERIOD_MS);
+    configPrint(Serial, config);
+
+  } else if (input == 'g') {
+    configPrint(Serial, config);
+
+  } else if (input == 'w') {
+    configSave(&config);
+    Serial.println("# Config saved");
+
+  } else {
+    // Unknown command - display help
+    Serial.println(SETUP_MSG);
+    Serial.println(CONFIG_MSG);
+  }
 }
 
 /**
- * Main loop - Wait for 'u' command to take a measurement
- * Outputs CSV format: serial_number, timestamp, temperature, humidity
+ * Command RX task - non-blocking replacement for Serial.parseInt()
+ * A numeric argument ends at the first non-digit or after COMMAND_ARG_TIMEOUT_MS
  */
-void loop() {
-  // Wait for serial input
-  while (!Serial.available()) {
-    delay(10);
-  }
-
-  char input = Serial.read();
-
-  // Take measurement on 'u' command
-  if (input == 'u') {
-    sensors_event_t humidity, temp;
-    
-    if (sht4.getEvent(&humidity, &temp)) {
-      // Successful measurement - indicate with magenta LED
-      pixel.setPixelColor(0, LED_MEASURING);
-      pixel.show();
-      
-      // Output data in CSV format
-      Serial.print("0x");
-      Serial.print(sht4SerialNumber, HEX);
-      Serial.print(", ");
-      Serial.print(millis() - startMeasurementTime);
-      Serial.print(", ");
-      Serial.print(temp.temperature);
-      Serial.print(", ");
-      Serial.println(humidity.relative_humidity);
-      
-      // Turn off LED and reset watchdog
-      pixel.setPixelColor(0, LED_OFF);
-      pixel.show();
-      Watchdog.reset();
-      
+void commandTask() {
+  heartbeat(TASK_COMMAND, COMMAND_HEARTBEAT_MS);
+  if (usbConfigured()) {
+    bootMark(BOOT_USB_CONFIGURED);
+  }
+  bool connected = usbHostConnected();
+  if (connected && !hostConnected) {
+    bootMark(BOOT_PORT_OPEN);
+    printBanner();
+    schedulerWake(TASK_OUTPUT);  // Flush samples buffered while disconnected
+  }
+  hostConnected = connected;
+
+#if FEATURE_MULTI_SENSOR
+  if (!Serial.available()) {
+    lastIdlePollUs = micros();  // Bounds the receipt latency of the next trigger
+  }
+#endif
+  for (uint8_t budget = COMMAND_RX_BUDGET; budget > 0 && Serial.available(); budget--) {
+    char input = Serial.read();
+
+    if (pendingCommand) {
+      if (input >= '0' && input <= '9') {
+        pendingArgument = pendingArgument * 10 + (input - '0');
+        pendingSince = millis();
+        continue;
+      }
+      dispatchCommand(pendingCommand, pendingArgument);
+      pendingCommand = 0;
+    }
+
+    if (commandTakesArgument(input)) {
+      pendingCommand = input;
+      pendingArgument = 0;
+      pendingSince = millis();
     } else {
-      // Error reading sensor - indicate with yellow LED
-      pixel.setPixelColor(0, LED_ERROR);
-      pixel.show();
-      Serial.println("Error reading from sensor, retrying...");
+      dispatchCommand(input, 0);
+#if FEATURE_MULTI_SENSOR
+      if (input == TRIGGER_COMMAND) {
+        break;  // Let the acquisition task start the conversion right away
+      }
+#endif
+    }
+  }
+
+  if (pendingCommand && millis() - pendingSince > COMMAND_ARG_TIMEOUT_MS) {
+    dispatchCommand(pendingCommand, pendingArgument);
+    pendingCommand = 0;
+  }
+}
+
+static_assert(TASK_COUNT <= SUPERVISOR_MAX_TASKS, "Heartbeats are indexed by TaskId");
+
+// Task table, indexed by TaskId
+// name, priority, period (ms), deadline (ms), function, core (FreeRTOS build)
+// Sensor I/O runs on core 1, USB transport and housekeeping on core 0
+Task tasks[TASK_COUNT] = {
+  {"acquisition", 0, 0, 2, acquisitionTask, 1},
+  {"command", 1, 2, 5, commandTask, 0},
+  {"output", 2, 0, 10, outputTask, 0},
+#if FEATURE_DECONTAMINATION
+  {"heater", 3, 0, 50, heaterTask, 1},
+#endif
+#if FEATURE_LED
+  {"led", 4, 0, 50, ledTask, 0},
+#endif
+#if FEATURE_WATCHDOG
+  {"watchdog", 5, WATCHDOG_CHECK_MS, 1000, watchdogTask, 0},
+#endif
+#if FEATURE_MULTI_SENSOR
+  {"timebase", 6, SOF_CALIBRATE_MS, 1000, timebaseTask, 0},
+#endif
+#if FEATURE_DIAGNOSTICS
+  {"noise", 3, 0, 50, noiseTask, 1},
+#endif
+};
+
+#if FEATURE_WATCHDOG
+/**
+ * After a watchdog reset, pick up where saveStateBeforeReset() left off
+ * Timestamps continue from the saved measurement time plus the time spent
+ * in the reset and boot, the saved samples are queued ahead of new ones
+ */
+void restoreStateAfterReset() {
+  if (!watchdogCausedReset() || !retainedLoad()) {
+    return;
+  }
+  config = retained.config;
+  config.format = supportedFormat(config.format);
+  for (uint8_t i = 0; i < retained.sampleCount; i++) {
+    samples.push(retained.samples[i]);
+  }
+  if (retained.mode == MODE_MEASURING) {
+    startMeasurement(retained.elapsedMs + millis());
+#if FEATURE_MULTI_SENSOR
+    triggerArmed = retained.triggerArmed;
+#endif
+  }
+  sampleSequence = retained.sequence;
+  resumedAfterReset = true;
+  retainedClear();
+}
+#endif
+
+/**
+ * Setup function - Initialize hardware and start the scheduler
+ * Nothing waits for the USB host: the core attaches USB before setup(), so
+ * enumeration proceeds in the background, and the banner is printed once a
+ * host opens the port
+ */
+void setup() {
+#if FEATURE_LED
+  // Initialize NeoPixel and set to blue (initializing)
+  pixel.begin();
+  pixel.setPixelColor(0, LED_INIT);
+  pixel.show();
+  bootMark(BOOT_PIXEL);
+#endif
+
+  // Initialize and verify SHT4x sensor
+  if (!sht4xBegin()) {
+#if FEATURE_LED
+    pixel.setPixelColor(0, LED_ERROR);
+    pixel.show();
+#endif
+    Serial.begin(115200);
+    while (!Serial) {
+      delay(10);
     }
+    Serial.println("# Couldn't find SHT4x");
+    while (1) delay(1);  // Halt execution if sensor not found
+  }
+  bootMark(BOOT_SENSOR);
+  sht4xReadSerial(&sht4SerialNumber);
+  bootMark(BOOT_SERIAL_NUMBER);
+
+  // Initialize serial communication at 115200 baud
+  Serial.begin(115200);
+  configLoad(&config);
+  config.format = supportedFormat(config.format);  // Saved by a build with both formats
+  bootMark(BOOT_CONFIG);
+
+  schedulerBegin(tasks, TASK_COUNT);
+#if FEATURE_WATCHDOG
+  watchdogSetWarning(saveStateBeforeReset);
+  watchdogTimeoutMs = watchdogEnable(WATCHDOG_TIMEOUT_MS);
+#endif
+  schedulerWake(TASK_ACQUISITION);  // Run up to the first CO_AWAIT_SIGNAL
+
+#if FEATURE_WATCHDOG
+  restoreStateAfterReset();
+#endif
+  if (mode == MODE_MEASURING) {
+    setLed(LED_OFF);
+  } else if (config.autostart) {
+    startMeasurement();
+    setLed(LED_OFF);
+  } else {
+    // Set LED to gray (ready state)
+    setLed(LED_READY);
+  }
+  clockBegin();
+  isrLatencyBegin();
+  bootMark(BOOT_SCHEDULER);
+}
+
+/**
+ * Main loop - run the most urgent ready task, idle at a low clock
+ */
+void loop() {
+  if (!schedulerRunOnce()) {
+    clockIdle();
   }
-  // Note: Other commands are ignored in measurement mode
 }
@@ -0,0 +1,37 @@
+#include <stddef.h>
+#include "retained_state.h"
+#include "binary_protocol.h"
+#include "feature_flags.h"
+
+#if FEATURE_WATCHDOG
+
+#if defined(ARDUINO_ARCH_SAMD)
+// NOLOAD region at the top of RAM, outside .data/.bss and clear of the UF2
+// bootloader (ld/trinkey_m0_retained.ld)
+RetainedState retained __attribute__((section(".retained")));
+#elif defined(ARDUINO_ARCH_RP2040)
+RetainedState __uninitialized_ram(retained);
+#else
+RetainedState retained;
+#endif
+
+static uint8_t retainedCrc() {
+  return crc8((const uint8_t *)&retained, offsetof(RetainedState, crc));
+}
+
+void retainedCommit() {
+  retained.magic = RETAINED_MAGIC;
+  retained.crc = retainedCrc();
+}
+
+bool retainedLoad() {
+  // After power-up the RAM holds noise, which the magic and CRC reject
+  return retained.magic == RETAINED_MAGIC && retained.crc == retainedCrc() &&
+         retained.sampleCount <= RETAINED_SAMPLES;
+}
+
+void retainedClear() {
+  retained.magic = 0;
+}
+
+#endif  // FEATURE_WATCHDOG
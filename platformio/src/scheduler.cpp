@@ -0,0 +1,133 @@
+#include "scheduler.h"
+
+#ifndef PIO_FRAMEWORK_ARDUINO_ENABLE_FREERTOS
+
+static Task *taskTable = nullptr;
+static uint8_t taskCount = 0;
+static volatile uint8_t runningTask = SCHEDULER_NO_TASK;
+
+// Wrap-safe "a is at or after b" for millis() values
+static inline bool timeReached(uint32_t now, uint32_t at) {
+  return (int32_t)(now - at) >= 0;
+}
+
+void schedulerBegin(Task *tasks, uint8_t count) {
+  taskTable = tasks;
+  taskCount = count;
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < count; i++) {
+    Task &task = tasks[i];
+    task.released = task.periodMs > 0;
+    task.releaseAt = now;
+    task.runs = 0;
+    task.deadlineMisses = 0;
+    task.maxLatencyMs = 0;
+    task.maxRunUs = 0;
+    task.totalRunUs = 0;
+  }
+}
+
+void schedulerWake(uint8_t taskId, uint32_t delayMs) {
+  if (taskId >= taskCount) {
+    return;
+  }
+  Task &task = taskTable[taskId];
+  uint32_t at = millis() + delayMs;
+  if (!task.released || (int32_t)(at - task.releaseAt) < 0) {
+    task.releaseAt = at;
+  }
+  task.released = true;
+}
+
+void schedulerCancel(uint8_t taskId) {
+  if (taskId < taskCount) {
+    taskTable[taskId].released = false;
+  }
+}
+
+bool schedulerRunOnce() {
+  uint32_t now = millis();
+  Task *next = nullptr;
+
+  for (uint8_t i = 0; i < taskCount; i++) {
+    Task &task = taskTable[i];
+    if (!task.released || !timeReached(now, task.releaseAt)) {
+      continue;
+    }
+    if (next == nullptr || task.priority < next->priority ||
+        (task.priority == next->priority &&
+         (int32_t)((task.releaseAt + task.deadlineMs) - (next->releaseAt + next->deadlineMs)) < 0)) {
+      next = &task;
+    }
+  }
+  if (next == nullptr) {
+    return false;
+  }
+
+  uint32_t latency = now - next->releaseAt;
+  if (latency > next->deadlineMs) {
+    next->deadlineMisses++;
+  }
+  if (latency > next->maxLatencyMs) {
+    next->maxLatencyMs = latency;
+  }
+
+  // Re-arm before running so the task can override its own next release
+  if (next->periodMs > 0) {
+    next->releaseAt += next->periodMs;
+    if (timeReached(now, next->releaseAt)) {
+      next->releaseAt = now + next->periodMs;  // Fell behind, skip missed periods
+    }
+  } else {
+    next->released = false;
+  }
+
+  uint32_t start = micros();
+  runningTask = next - taskTable;
+  next->run();
+  runningTask = SCHEDULER_NO_TASK;
+  uint32_t runUs = micros() - start;
+  next->runs++;
+  next->totalRunUs += runUs;
+  if (runUs > next->maxRunUs) {
+    next->maxRunUs = runUs;
+  }
+  return true;
+}
+
+uint8_t schedulerRunningTask() {
+  return runningTask;
+}
+
+void schedulerLock() {}
+
+void schedulerUnlock() {}
+
+// No task runs while an interrupt handler does
+uint32_t schedulerLockFromIsr() {
+  return 0;
+}
+
+void schedulerUnlockFromIsr(uint32_t) {}
+
+void schedulerPrintStats(Print &out) {
+  uint32_t uptimeMs = millis();
+  out.println("# task, runs, deadline misses, max latency (ms), max run (us), cpu (%)");
+  for (uint8_t i = 0; i < taskCount; i++) {
+    const Task &task = taskTable[i];
+    out.print("# ");
+    out.print(task.name);
+    out.print(", ");
+    out.print(task.runs);
+    out.print(", ");
+    out.print(task.deadlineMisses);
+    out.print(", ");
+    out.print(task.maxLatencyMs);
+    out.print(", ");
+    out.print(task.maxRunUs);
+    out.print(", ");
+    out.println(uptimeMs ? task.totalRunUs / 10.0 / uptimeMs : 0.0);
+  }
+}
+
+#endif  // !PIO_FRAMEWORK_ARDUINO_ENABLE_FREERTOS
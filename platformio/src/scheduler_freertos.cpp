@@ -0,0 +1,176 @@
+/*
+ * FreeRTOS-SMP backend of scheduler.h for the RP2040
+ *
+ * Each task table entry runs in its own FreeRTOS task, pinned to
+ * Task::core and prioritised from Task::priority. Release times keep the
+ * cooperative semantics: periodic tasks re-arm themselves, event tasks
+ * sleep on a task notification until schedulerWake() releases them.
+ */
+
+#include "scheduler.h"
+
+#ifdef PIO_FRAMEWORK_ARDUINO_ENABLE_FREERTOS
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#define RTOS_TASK_STACK_WORDS 1024
+
+static Task *taskTable = nullptr;
+static uint8_t taskCount = 0;
+static TaskHandle_t taskHandles[16];
+
+void schedulerLock() {
+  taskENTER_CRITICAL();
+}
+
+void schedulerUnlock() {
+  taskEXIT_CRITICAL();
+}
+
+uint32_t schedulerLockFromIsr() {
+  return taskENTER_CRITICAL_FROM_ISR();
+}
+
+void schedulerUnlockFromIsr(uint32_t state) {
+  taskEXIT_CRITICAL_FROM_ISR(state);
+}
+
+static void runTask(void *param) {
+  Task &task = *(Task *)param;
+
+  for (;;) {
+    schedulerLock();
+    bool released = task.released;
+    int32_t wait = (int32_t)(task.releaseAt - millis());
+    schedulerUnlock();
+
+    if (!released) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    if (wait > 0) {
+      // An earlier schedulerWake() cuts the wait short
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+      continue;
+    }
+
+    uint32_t now = millis();
+    uint32_t latency = now - task.releaseAt;
+    schedulerLock();
+    if (task.periodMs > 0) {
+      task.releaseAt += task.periodMs;
+      if ((int32_t)(now - task.releaseAt) >= 0) {
+        task.releaseAt = now + task.periodMs;  // Fell behind, skip missed periods
+      }
+    } else {
+      task.released = false;
+    }
+    schedulerUnlock();
+
+    if (latency > task.deadlineMs) {
+      task.deadlineMisses++;
+    }
+    if (latency > task.maxLatencyMs) {
+      task.maxLatencyMs = latency;
+    }
+
+    uint32_t start = micros();
+    task.run();
+    uint32_t runUs = micros() - start;
+    task.runs++;
+    task.totalRunUs += runUs;
+    if (runUs > task.maxRunUs) {
+      task.maxRunUs = runUs;
+    }
+  }
+}
+
+void schedulerBegin(Task *tasks, uint8_t count) {
+  taskTable = tasks;
+  taskCount = min(count, (uint8_t)(sizeof(taskHandles) / sizeof(taskHandles[0])));
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < taskCount; i++) {
+    Task &task = tasks[i];
+    task.released = task.periodMs > 0;
+    task.releaseAt = now;
+    task.runs = 0;
+    task.deadlineMisses = 0;
+    task.maxLatencyMs = 0;
+    task.maxRunUs = 0;
+    task.totalRunUs = 0;
+
+    // Priority 0 in the table is the most urgent, FreeRTOS counts upwards
+    UBaseType_t priority = task.priority + 2 < configMAX_PRIORITIES
+                               ? configMAX_PRIORITIES - 2 - task.priority
+                               : tskIDLE_PRIORITY + 1;
+    // Pinned from creation, so the task never starts on the other core
+    xTaskCreateAffinitySet(runTask, task.name, RTOS_TASK_STACK_WORDS, &task, priority,
+                           1 << task.core, &taskHandles[i]);
+  }
+}
+
+void schedulerWake(uint8_t taskId, uint32_t delayMs) {
+  if (taskId >= taskCount) {
+    return;
+  }
+  Task &task = taskTable[taskId];
+  uint32_t at = millis() + delayMs;
+  schedulerLock();
+  if (!task.released || (int32_t)(at - task.releaseAt) < 0) {
+    task.releaseAt = at;
+  }
+  task.released = true;
+  schedulerUnlock();
+  xTaskNotifyGive(taskHandles[taskId]);
+}
+
+void schedulerCancel(uint8_t taskId) {
+  if (taskId < taskCount) {
+    schedulerLock();
+    taskTable[taskId].released = false;
+    schedulerUnlock();
+  }
+}
+
+uint8_t schedulerRunningTask() {
+  TaskHandle_t current = xTaskGetCurrentTaskHandle();
+  for (uint8_t i = 0; i < taskCount; i++) {
+    if (taskHandles[i] == current) {
+      return i;
+    }
+  }
+  return SCHEDULER_NO_TASK;
+}
+
+bool schedulerRunOnce() {
+  // The tasks run on their own, the Arduino loop task just sleeps
+  vTaskDelay(pdMS_TO_TICKS(1000));
+  return false;
+}
+
+void schedulerPrintStats(Print &out) {
+  uint32_t uptimeMs = millis();
+  out.println("# task, runs, deadline misses, max latency (ms), max run (us), cpu (%), core, free stack (words)");
+  for (uint8_t i = 0; i < taskCount; i++) {
+    const Task &task = taskTable[i];
+    out.print("# ");
+    out.print(task.name);
+    out.print(", ");
+    out.print(task.runs);
+    out.print(", ");
+    out.print(task.deadlineMisses);
+    out.print(", ");
+    out.print(task.maxLatencyMs);
+    out.print(", ");
+    out.print(task.maxRunUs);
+    out.print(", ");
+    out.print(uptimeMs ? task.totalRunUs / 10.0 / uptimeMs : 0.0);
+    out.print(", ");
+    out.print(task.core);
+    out.print(", ");
+    out.println((unsigned long)uxTaskGetStackHighWaterMark(taskHandles[i]));
+  }
+}
+
+#endif  // PIO_FRAMEWORK_ARDUINO_ENABLE_FREERTOS
@@ -0,0 +1,61 @@
+#include "supervisor.h"
+
+#if FEATURE_WATCHDOG
+#include "scheduler.h"
+
+static bool armed[SUPERVISOR_MAX_TASKS];
+static uint32_t dueAt[SUPERVISOR_MAX_TASKS];  // millis() by which the next heartbeat is due
+
+void heartbeat(uint8_t taskId, uint32_t deadlineMs) {
+  if (taskId >= SUPERVISOR_MAX_TASKS) {
+    return;
+  }
+  schedulerLock();
+  dueAt[taskId] = millis() + deadlineMs;
+  armed[taskId] = true;
+  schedulerUnlock();
+}
+
+void heartbeatIdle(uint8_t taskId) {
+  if (taskId >= SUPERVISOR_MAX_TASKS) {
+    return;
+  }
+  schedulerLock();
+  armed[taskId] = false;
+  schedulerUnlock();
+}
+
+void supervisorPostpone(uint32_t ms) {
+  schedulerLock();
+  for (uint8_t i = 0; i < SUPERVISOR_MAX_TASKS; i++) {
+    dueAt[i] += ms;
+  }
+  schedulerUnlock();
+}
+
+static uint8_t findOverdue(uint32_t now) {
+  for (uint8_t i = 0; i < SUPERVISOR_MAX_TASKS; i++) {
+    if (armed[i] && (int32_t)(now - dueAt[i]) > 0) {
+      return i;
+    }
+  }
+  return SUPERVISOR_HEALTHY;
+}
+
+uint8_t supervisorCheck() {
+  uint32_t now = millis();
+  schedulerLock();
+  uint8_t overdue = findOverdue(now);
+  schedulerUnlock();
+  return overdue;
+}
+
+uint8_t supervisorCheckFromIsr() {
+  uint32_t now = millis();
+  uint32_t state = schedulerLockFromIsr();
+  uint8_t overdue = findOverdue(now);
+  schedulerUnlockFromIsr(state);
+  return overdue;
+}
+
+#endif  // FEATURE_WATCHDOG
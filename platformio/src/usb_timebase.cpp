@@ -0,0 +1,84 @@
+#include "usb_timebase.h"
+#include "feature_flags.h"
+
+#if FEATURE_MULTI_SENSOR
+#include "scheduler.h"
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include "hardware/structs/usb.h"
+#endif
+
+// Last calibration: micros() at the start of edgeFrame
+static bool edgeValid = false;
+static uint16_t edgeFrame;
+static uint32_t edgeUs;
+
+uint16_t usbFrameNumber() {
+#if defined(ARDUINO_ARCH_RP2040)
+  return usb_hw->sof_rd & USB_SOF_RD_BITS;
+#else
+  return USB->DEVICE.FNUM.bit.FNUM;
+#endif
+}
+
+bool usbTimebaseCalibrate() {
+  uint16_t frame = usbFrameNumber();
+  uint32_t start = micros();
+  uint32_t now;
+  uint16_t current;
+  do {
+    now = micros();
+    current = usbFrameNumber();
+    if (current != frame) {
+      schedulerLock();
+      edgeFrame = current;
+      edgeUs = now;
+      edgeValid = true;
+      schedulerUnlock();
+      return true;
+    }
+  } while (now - start < SOF_FRAME_US + SOF_FRAME_US / 4);
+
+  schedulerLock();
+  edgeValid = false;  // Frame counter stopped: no host or bus suspended
+  schedulerUnlock();
+  return false;
+}
+
+SofStamp usbTimebaseLatch() {
+  SofStamp stamp = {SOF_INVALID, 0};
+  schedulerLock();
+  bool valid = edgeValid;
+  uint16_t lastFrame = edgeFrame;
+  uint32_t lastUs = edgeUs;
+  schedulerUnlock();
+  if (!valid) {
+    return stamp;
+  }
+  uint32_t now = micros();
+  uint16_t frame = usbFrameNumber();
+  uint32_t elapsed = now - lastUs;
+  uint16_t predicted = (lastFrame + elapsed / SOF_FRAME_US) & SOF_FRAME_MASK;
+
+  stamp.frame = frame;
+  if (predicted == frame) {
+    stamp.offsetUs = elapsed % SOF_FRAME_US;
+  } else if (((predicted - frame) & SOF_FRAME_MASK) < SOF_FRAME_MASK / 2) {
+    stamp.offsetUs = SOF_FRAME_US - 1;  // Extrapolation ran ahead of the bus
+  } else {
+    stamp.offsetUs = 0;                 // Frame started before the prediction
+  }
+  return stamp;
+}
+
+SofStamp sofAdvance(SofStamp stamp, uint32_t us) {
+  if (stamp.frame == SOF_INVALID) {
+    return stamp;
+  }
+  uint32_t offset = stamp.offsetUs + us;
+  stamp.frame = (stamp.frame + offset / SOF_FRAME_US) & SOF_FRAME_MASK;
+  stamp.offsetUs = offset % SOF_FRAME_US;
+  return stamp;
+}
+
+#endif  // FEATURE_MULTI_SENSOR
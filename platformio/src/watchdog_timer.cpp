@@ -0,0 +1,106 @@
+#include "watchdog_timer.h"
+#include "feature_flags.h"
+
+#if FEATURE_WATCHDOG
+
+static WatchdogWarning warningHandler = nullptr;
+
+void watchdogSetWarning(WatchdogWarning handler) {
+  warningHandler = handler;
+}
+
+#if defined(ARDUINO_ARCH_SAMD)
+
+#define WDT_CLOCK_HZ 1024  // OSCULP32K / 32 through GCLK2
+
+// PER and EWOFFSET encode 8 << code cycles
+static uint8_t cyclesCode(uint32_t ms) {
+  uint8_t code = 0;
+  while (code < 11 && (8UL << code) < ms * WDT_CLOCK_HZ / 1000) {
+    code++;
+  }
+  return code;
+}
+
+int watchdogEnable(uint32_t timeoutMs) {
+  GCLK->GENDIV.reg = GCLK_GENDIV_ID(2) | GCLK_GENDIV_DIV(4);
+  GCLK->GENCTRL.reg = GCLK_GENCTRL_ID(2) | GCLK_GENCTRL_GENEN |
+                      GCLK_GENCTRL_SRC_OSCULP32K | GCLK_GENCTRL_DIVSEL;
+  while (GCLK->STATUS.bit.SYNCBUSY);
+  GCLK->CLKCTRL.reg = GCLK_CLKCTRL_ID_WDT | GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK2;
+
+  WDT->CTRL.reg = 0;
+  while (WDT->STATUS.bit.SYNCBUSY);
+  uint8_t period = cyclesCode(timeoutMs);
+  WDT->CONFIG.reg = WDT_CONFIG_PER(period);
+  WDT->EWCTRL.reg = WDT_EWCTRL_EWOFFSET(period - 1);  // Halfway
+  WDT->INTFLAG.reg = WDT_INTFLAG_EW;
+  WDT->INTENSET.reg = WDT_INTENSET_EW;
+  NVIC_ClearPendingIRQ(WDT_IRQn);
+  NVIC_SetPriority(WDT_IRQn, 0);
+  NVIC_EnableIRQ(WDT_IRQn);
+  WDT->CTRL.reg = WDT_CTRL_ENABLE;
+  while (WDT->STATUS.bit.SYNCBUSY);
+  return (8UL << period) * 1000 / WDT_CLOCK_HZ;
+}
+
+void watchdogFeed() {
+  // A clear still synchronising counts, the next feed is 100 ms away
+  if (!WDT->STATUS.bit.SYNCBUSY) {
+    WDT->CLEAR.reg = WDT_CLEAR_CLEAR_KEY;
+  }
+}
+
+bool watchdogCausedReset() {
+  return PM->RCAUSE.bit.WDT;
+}
+
+extern "C" void WDT_Handler() {
+  WDT->INTFLAG.reg = WDT_INTFLAG_EW;
+  if (warningHandler) {
+    warningHandler();
+  }
+}
+
+#elif defined(ARDUINO_ARCH_RP2040)
+#include "hardware/timer.h"
+#include "hardware/watchdog.h"
+#include "ram_func.h"
+
+static int warningAlarm = -1;
+static uint32_t warningDelayMs;
+
+static void RAM_FUNC(onWarningAlarm)(uint alarm) {
+  (void)alarm;
+  if (warningHandler) {
+    warningHandler();
+  }
+}
+
+static void armWarning() {
+  if (warningAlarm >= 0) {
+    hardware_alarm_set_target(warningAlarm, make_timeout_time_ms(warningDelayMs));
+  }
+}
+
+int watchdogEnable(uint32_t timeoutMs) {
+  warningDelayMs = timeoutMs / 2;
+  warningAlarm = hardware_alarm_claim_unused(true);
+  hardware_alarm_set_callback(warningAlarm, onWarningAlarm);
+  watchdog_enable(timeoutMs, true);  // Paused while a debugger halts the cores
+  armWarning();
+  return timeoutMs;
+}
+
+void watchdogFeed() {
+  watchdog_update();
+  armWarning();
+}
+
+bool watchdogCausedReset() {
+  return watchdog_enable_caused_reboot();
+}
+
+#endif
+
+#endif  // FEATURE_WATCHDOG
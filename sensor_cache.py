@@ -0,0 +1,125 @@
+"""Typed, memory-mappable cache of the sensor_readings_*.csv logs.
+
+Each CSV is converted once into one .npy file per column inside
+CACHE_DIR/<csv stem>-<hash>/, sorted by timestamp, plus a sparse index
+holding every INDEX_STRIDE-th timestamp. The directory name carries the
+SHA-256 of the source file, so editing or appending to the CSV triggers a
+rebuild on the next load and stale caches for the same CSV are removed.
+"""
+
+import hashlib
+import json
+import shutil
+from pathlib import Path
+
+import numpy as np
+import pandas as pd
+
+CACHE_DIR = Path(".sensor_cache")
+CACHE_VERSION = 1
+INDEX_STRIDE = 1024  # Rows between sparse index entries
+HASH_LENGTH = 16  # Hex digits of the SHA-256 kept in the directory name
+TIMESTAMP_COLUMN = "timestamp"
+
+
+def file_hash(path):
+    """SHA-256 of the file contents, truncated to HASH_LENGTH hex digits."""
+    digest = hashlib.sha256()
+    with open(path, "rb") as file:
+        for chunk in iter(lambda: file.read(1 << 20), b""):
+            digest.update(chunk)
+    return digest.hexdigest()[:HASH_LENGTH]
+
+
+class SensorReadings:
+    """Timestamp-sorted columns of one log, backed by memory-mapped arrays."""
+
+    def __init__(self, timestamp, columns, index, index_stride=INDEX_STRIDE, offset=0):
+        self.timestamp = timestamp
+        self.columns = columns  # Column name -> float32 array, NaN where the device had no reading
+        self.index = index
+        self.index_stride = index_stride
+        self.offset = offset  # Row offset of this view into the cached arrays
+
+    def __len__(self):
+        return len(self.timestamp)
+
+    def __getitem__(self, name):
+        if name == TIMESTAMP_COLUMN:
+            return self.timestamp
+        return self.columns[name]
+
+    def locate(self, timestamp_ms, side="left"):
+        """Row position of timestamp_ms, touching at most one index stride of data."""
+        block = max(np.searchsorted(self.index, timestamp_ms, side=side) - 1, 0)
+        start = block * self.index_stride
+        end = min(start + self.index_stride + 1, len(self.timestamp))
+        return start + int(np.searchsorted(self.timestamp[start:end], timestamp_ms, side=side))
+
+    def slice(self, start_ms=None, end_ms=None):
+        """Rows with start_ms <= timestamp < end_ms as a zero-copy view."""
+        start = 0 if start_ms is None else self.locate(start_ms)
+        end = len(self.timestamp) if end_ms is None else self.locate(end_ms)
+        return SensorReadings(
+            self.timestamp[start:end],
+            {name: column[start:end] for name, column in self.columns.items()},
+            self.index,
+            self.index_stride,
+            self.offset + start,
+        )
+
+    def to_dataframe(self):
+        """Same layout as pd.read_csv on the source file, sorted by timestamp."""
+        data = {TIMESTAMP_COLUMN: np.asarray(self.timestamp)}
+        data.update((name, np.asarray(column)) for name, column in self.columns.items())
+        return pd.DataFrame(data)
+
+
+def build_cache(csv_path, cache_path):
+    """Convert csv_path into typed column files under cache_path."""
+    df = pd.read_csv(csv_path)
+    df = df.sort_values(TIMESTAMP_COLUMN, kind="stable")
+    columns = [name for name in df.columns if name != TIMESTAMP_COLUMN]
+
+    # Write into a temporary directory so an interrupted build is never loaded
+    tmp_path = cache_path.with_name(cache_path.name + ".tmp")
+    shutil.rmtree(tmp_path, ignore_errors=True)
+    tmp_path.mkdir(parents=True)
+    timestamp = df[TIMESTAMP_COLUMN].to_numpy(dtype=np.int64)
+    np.save(tmp_path / "timestamp.npy", timestamp)
+    np.save(tmp_path / "index.npy", timestamp[::INDEX_STRIDE].copy())
+    for i, name in enumerate(columns):
+        np.save(tmp_path / f"column_{i:03d}.npy", df[name].to_numpy(dtype=np.float32))
+    meta = {
+        "version": CACHE_VERSION,
+        "source": str(csv_path),
+        "rows": len(df),
+        "index_stride": INDEX_STRIDE,
+        "columns": columns,
+    }
+    (tmp_path / "meta.json").write_text(json.dumps(meta, indent=2))
+    shutil.rmtree(cache_path, ignore_errors=True)
+    tmp_path.rename(cache_path)
+
+
+def load_readings(csv_path, cache_dir=CACHE_DIR):
+    """Load a sensor log through the cache, rebuilding it if the CSV changed."""
+    csv_path = Path(csv_path)
+    cache_dir = Path(cache_dir)
+    cache_path = cache_dir / f"{csv_path.stem}-{file_hash(csv_path)}"
+    meta_path = cache_path / "meta.json"
+
+    meta = json.loads(meta_path.read_text()) if meta_path.exists() else None
+    if meta is None or meta.get("version") != CACHE_VERSION:
+        for stale in cache_dir.glob(f"{csv_path.stem}-*"):
+            shutil.rmtree(stale, ignore_errors=True)
+        build_cache(csv_path, cache_path)
+        meta = json.loads(meta_path.read_text())
+
+    timestamp = np.load(cache_path / "timestamp.npy", mmap_mode="r")
+    index = np.load(cache_path / "index.npy")
+    columns = {
+        name: np.load(cache_path / f"column_{i:03d}.npy", mmap_mode="r")
+        for i, name in enumerate(meta["columns"])
+    }
+    return SensorReadings(timestamp, columns, index, meta["index_stride"])
@@ -1,5 +1,8 @@
 import time
 import csv
+import struct
+from collections import namedtuple
+import numpy as np
 import serial
 import serial.tools.list_ports
 
@@ -8,21 +11,97 @@ BAUD_RATE = 115200
 BASE_CSV_FILE_PATH = "sensor_readings"
 SENSOR_READ_INTERVAL = 1  # seconds
 
+# Protocol negotiation
+CAPS_COMMAND = b"c"  # Ask the firmware for its capability descriptor
+CAPS_PREFIX = "caps:"  # Capability lines look like "caps: fw=1.2.0 proto=4 fmt=csv,bin"
+FORMAT_COMMAND = b"f"  # Followed by the format code, e.g. b"f1" selects binary frames
+FORMAT_CODES = {"csv": 0, "bin": 1}
+PREFERRED_FORMATS = ("bin", "csv")  # Most efficient first, CSV is always the fallback
+STOP_COMMAND = b"x"  # Leave measurement mode, e.g. on a board that autostarted
+ARM_TRIGGER_COMMAND = b"k1\n"  # Pre-arm for broadcast triggers after 's'
+TRIGGER_COMMAND = b"*"  # Sample now on every armed device
+
+# Binary frame layout: SYNC | type (u8) | length (u8) | payload | CRC-8
+FRAME_SYNC = b"\xa5\x5a"
+FRAME_HEADER_SIZE = len(FRAME_SYNC) + 2
+FRAME_MAX_PAYLOAD = 64
+# serial (u32), timestamp ms (u32), T ticks (u16), RH ticks (u16),
+# USB frame number (u16), offset into frame in us (u16), conversion window in us (u16),
+# sample sequence (u32)
+FRAME_TYPE_RAW_SOF = 0x03
+RAW_SOF_PAYLOAD = struct.Struct("<IIHHHHHI")
+# USB start-of-frame timebase: one 11-bit frame number per ms, shared by all devices on a bus
+SOF_FRAME_MODULO = 2048
+SOF_INVALID = 0xFFFF  # Device had no frame counter, e.g. bus suspended
+# Reset recovery: a rebooted device prints its banner and help text and waits for 's' again
+RESET_MARKERS = ("# Adafruit SHT41", "Send 's' to start measurement")
+# A watchdog reset that restored its state keeps measuring and needs no re-arm
+RESUME_MARKER = "# Resumed after watchdog reset"
+# The resume line comes before the end of the banner: the help text, or the CSV header
+# of a device that is measuring
+BANNER_END = (RESET_MARKERS[1], "# sht4SerialNumber")
+OUTAGE_HEADER = ["serial_number", "port", "outage_start", "outage_end", "outage (s)"]
+
+MAX_TEXT_LINE = 256  # Bytes of unterminated text kept before it is treated as garbage
+
 serial_number_to_color = {
     "0xEFCF86D7": "yellow",
     "0xF030D05B": "blue",
     "0xF030D0CF": "red",
 }
 
+# Per-device linear calibration applied after the SHT4x transfer functions:
+# value = gain * converted + offset
+serial_number_to_calibration = {
+    # "0xF030D05B": Calibration(temperature_offset=-0.1, humidity_offset=0.5),
+}
+
 assert type(SENSOR_READ_INTERVAL) is int, "SENSOR_READ_INTERVAL must be an integer."
 assert SENSOR_READ_INTERVAL > 0, "SENSOR_READ_INTERVAL must be greater than 0."
 
+# sequence counts the samples since 's', None from firmware that does not number them
+Sample = namedtuple(
+    "Sample",
+    ["serial_number", "timestamp", "temperature", "humidity", "sequence"],
+    defaults=[None],
+)
+RawSample = namedtuple(
+    "RawSample",
+    [
+        "serial_number",
+        "timestamp",
+        "t_ticks",
+        "rh_ticks",
+        "sof_frame",
+        "sof_offset_us",
+        "conversion_us",
+        "sequence",
+    ],
+)
+Calibration = namedtuple(
+    "Calibration",
+    ["temperature_offset", "temperature_gain", "humidity_offset", "humidity_gain"],
+    defaults=[0.0, 1.0, 0.0, 1.0],
+)
+
 
 class MySerial(serial.Serial):
     """Custom serial class to handle specific device behavior."""
 
     def __init__(self, *args, **kwargs):
         super().__init__(*args, **kwargs)
+        self.caps = {}
+        self.decoder = CsvDecoder()
+        self.calibration = Calibration()
+        self.rearm_time = None  # Host time of the last re-arm, None while healthy
+        self.last_sample_time = None
+        self.last_timestamp = 0
+        self.timestamp_offset = 0  # Added to device timestamps after a reset
+        self.sof_anchor = None  # (device timestamp, unwrapped frame) of the last aligned sample
+        self.sof_aligned = False  # Timestamps are on the shared USB frame timebase, set by negotiate_format
+        self.in_banner = False  # Between a banner start and its end, which may come with a later read
+        self.next_sequence = None  # Expected sequence of the next sample, None after 's'
+        self.lost_samples = 0
 
     def setDeviceColorBySerialNumber(self, serial_number):
         """Set the device color based on its serial number."""
@@ -30,6 +109,7 @@ class MySerial(serial.Serial):
             color_max_length = max(
                 len(color) for color in serial_number_to_color.values()
             )
+            self.calibration = serial_number_to_calibration.get(serial_number, Calibration())
             self.color = serial_number_to_color[serial_number]
             self.device_with_color = (
                 f"{self.port} {f'({self.color})':>{color_max_length + 3}}"
@@ -42,19 +122,223 @@ class MySerial(serial.Serial):
             self.device_with_color = f"{self.port} ({self.color})"
 
 
+def crc8(data):
+    """Sensirion CRC-8 (polynomial 0x31, init 0xFF), the same check the SHT4x uses."""
+    crc = 0xFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x31) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+class CsvDecoder:
+    """Incrementally split the text stream into comment lines and samples."""
+
+    format_name = "csv"
+
+    def __init__(self):
+        self.buffer = bytearray()
+
+    def feed(self, data):
+        """Consume raw bytes and return a list of ("text", str) / ("sample", Sample) events."""
+        self.buffer += data
+        events = []
+        while True:
+            newline = self.buffer.find(b"\n")
+            if newline == -1:
+                if len(self.buffer) > MAX_TEXT_LINE:
+                    self.buffer.clear()
+                break
+            line = self.buffer[:newline].decode("utf-8", errors="replace").strip()
+            del self.buffer[: newline + 1]
+            events.extend(self.decode_line(line))
+        return events
+
+    @staticmethod
+    def decode_line(line):
+        if not line:
+            return []
+        if line.startswith("#"):
+            return [("text", line)]
+        try:
+            parsed = parse_sensor_line(line)
+        except ValueError:
+            parsed = None
+        if not parsed:
+            return [("text", line)]
+        return [("sample", Sample(*parsed))]
+
+
+class BinaryDecoder(CsvDecoder):
+    """Decode binary frames interleaved with text lines, resynchronising on corruption.
+
+    Text (banner, comments, errors) is still sent as newline-terminated ASCII,
+    which never contains the 0xA5 sync byte, so anything in front of a sync
+    marker is handled as text and everything after it as a candidate frame.
+    A frame with a bad length or CRC is skipped one byte at a time until the
+    next valid sync marker.
+    """
+
+    format_name = "bin"
+
+    def __init__(self):
+        super().__init__()
+        self.corrupted_frames = 0
+
+    def feed(self, data):
+        self.buffer += data
+        events = []
+        while True:
+            sync = self.buffer.find(FRAME_SYNC)
+            text_end = len(self.buffer) if sync == -1 else sync
+            newline = self.buffer.rfind(b"\n", 0, text_end)
+            if newline != -1:
+                for raw in self.buffer[:newline].split(b"\n"):
+                    line = raw.decode("utf-8", errors="replace").strip()
+                    events.extend(self.decode_line(line))
+                del self.buffer[: newline + 1]
+                continue
+            if sync == -1:
+                # Keep a possible half sync marker, drop runaway garbage
+                if len(self.buffer) > MAX_TEXT_LINE:
+                    del self.buffer[: -len(FRAME_SYNC) + 1]
+                break
+            if sync > 0:
+                # Unterminated text in front of a frame can only be line noise
+                del self.buffer[:sync]
+            if len(self.buffer) < FRAME_HEADER_SIZE:
+                break
+            frame_type, length = self.buffer[2], self.buffer[3]
+            if length > FRAME_MAX_PAYLOAD:
+                self.resync()
+                continue
+            frame_size = FRAME_HEADER_SIZE + length + 1
+            if len(self.buffer) < frame_size:
+                break
+            body = bytes(self.buffer[2 : frame_size - 1])
+            if crc8(body) != self.buffer[frame_size - 1]:
+                self.resync()
+                continue
+            del self.buffer[:frame_size]
+            events.extend(self.decode_frame(frame_type, body[2:]))
+        return events
+
+    def resync(self):
+        """Drop the current sync byte so the search continues after it."""
+        self.corrupted_frames += 1
+        del self.buffer[:1]
+
+    def decode_frame(self, frame_type, payload):
+        if frame_type == FRAME_TYPE_RAW_SOF and len(payload) >= RAW_SOF_PAYLOAD.size:
+            serial, *values = RAW_SOF_PAYLOAD.unpack_from(payload)
+            return [("raw", RawSample(f"0x{serial:X}", *values))]
+        # Unknown frame types are skipped so newer firmware stays readable
+        return []
+
+
+def convert_raw_ticks(t_ticks, rh_ticks, calibration=Calibration()):
+    """Convert arrays of raw SHT4x ticks to calibrated float32 T (degrees C) and RH (%).
+
+    Uses the datasheet transfer functions T = -45 + 175 * t / 65535 and
+    RH = -6 + 125 * rh / 65535, then clamps RH to the physical 0..100 % range.
+    """
+    t_ticks = np.asarray(t_ticks, dtype=np.float32)
+    rh_ticks = np.asarray(rh_ticks, dtype=np.float32)
+    temperature = np.float32(-45.0) + np.float32(175.0 / 65535.0) * t_ticks
+    humidity = np.float32(-6.0) + np.float32(125.0 / 65535.0) * rh_ticks
+    temperature = calibration.temperature_gain * temperature + calibration.temperature_offset
+    humidity = calibration.humidity_gain * humidity + calibration.humidity_offset
+    np.clip(humidity, 0.0, 100.0, out=humidity)
+    return temperature.astype(np.float32), humidity.astype(np.float32)
+
+
+def convert_raw_samples(raw_samples, calibration=Calibration()):
+    """Convert a batch of RawSample tuples into typed columns in one vector pass.
+
+    Returns (timestamps uint32, temperature float32, humidity float32).
+    """
+    if not raw_samples:
+        empty = np.empty(0, dtype=np.float32)
+        return np.empty(0, dtype=np.uint32), empty, empty
+    timestamps = [sample.timestamp for sample in raw_samples]
+    t_ticks = [sample.t_ticks for sample in raw_samples]
+    rh_ticks = [sample.rh_ticks for sample in raw_samples]
+    temperature, humidity = convert_raw_ticks(t_ticks, rh_ticks, calibration)
+    return np.asarray(timestamps, dtype=np.uint32), temperature, humidity
+
+
+def unwrap_frame(frame, expected):
+    """Unwrapped frame count closest to expected with the given 11-bit frame number."""
+    delta = (frame - expected) % SOF_FRAME_MODULO
+    if delta >= SOF_FRAME_MODULO // 2:
+        delta -= SOF_FRAME_MODULO
+    return expected + delta
+
+
+class SofTimebase:
+    """Place samples from all devices on one ms timebase counted in USB frames.
+
+    Every device latches the bus frame number (which wraps every 2.048 s)
+    and the time into that frame. Frame numbers are unwrapped per device
+    using its own timestamps, and a device's first sample is placed using
+    host time, which only has to be right to within a second. A sample
+    without a frame stamp (e.g. bus suspended) is placed by the device
+    clock from the previous one, so a device never changes timebase.
+    """
+
+    def __init__(self):
+        self.origin = None  # (host time, unwrapped frame) of the first aligned sample
+
+    def align(self, ser, raw, host_time):
+        """Shared timestamp in ms of one raw sample."""
+        if self.origin is None:
+            # Host time only selects the 2.048 s wrap, any frame number will do
+            self.origin = (host_time, 0 if raw.sof_frame == SOF_INVALID else raw.sof_frame)
+        if ser.sof_anchor is None:
+            host0, frame0 = self.origin
+            expected = frame0 + round((host_time - host0) * 1000)
+        else:
+            last_timestamp, last_frame = ser.sof_anchor
+            expected = last_frame + (raw.timestamp - last_timestamp)
+        if raw.sof_frame == SOF_INVALID:
+            frame, offset_ms = expected, 0.0
+        else:
+            frame, offset_ms = unwrap_frame(raw.sof_frame, expected), raw.sof_offset_us / 1000.0
+        ser.sof_anchor = (raw.timestamp, frame)
+        return frame + offset_ms
+
+
+DECODERS = {decoder.format_name: decoder for decoder in (CsvDecoder, BinaryDecoder)}
+
+
 def create_file_name(base_path):
     """Create a timestamped CSV filename."""
     timestamp_str = time.strftime("%Y%m%d_%H%M%S")
     return f"{base_path}_{timestamp_str}.csv"
 
 
+def create_outage_file_name(csv_file_path):
+    """Name of the file recording device outages next to the data CSV."""
+    return csv_file_path.replace(".csv", "_outages.csv")
+
+
 def parse_sensor_line(line):
     """Parse a sensor data line into its components."""
     parts = [x.strip() for x in line.split(",")]
-    if len(parts) != 4:
+    if len(parts) == 4:
+        # Firmware before protocol 4 does not number its samples
+        parts.append(None)
+    if len(parts) != 5:
         return None
-    serial_number, timestamp, temperature, humidity = parts
-    return serial_number, int(timestamp), float(temperature), float(humidity)
+    serial_number, timestamp, temperature, humidity, sequence = parts
+    return (
+        serial_number,
+        int(timestamp),
+        float(temperature),
+        float(humidity),
+        None if sequence is None else int(sequence),
+    )
 
 
 def get_adafruit_ports():
@@ -68,12 +352,55 @@ def get_serial_number(ser):
     try:
         ser.write(b"n")
         time.sleep(0.1)
-        return ser.readline().decode("utf-8").strip()
+        # Skip anything sent ahead of the reply, a CSV sample also starts with 0x
+        while line := ser.readline().decode("utf-8", errors="replace").strip():
+            if line.startswith("0x") and "," not in line:
+                return line
+        return None
     except Exception as e:
         print(f"Error reading serial number: {e}")
         return None
 
 
+def parse_caps_line(line):
+    """Parse "caps: key=value key=value ..." into a dict."""
+    caps = {}
+    for token in line[len(CAPS_PREFIX) :].split():
+        key, _, value = token.partition("=")
+        caps[key] = value
+    return caps
+
+
+def query_capabilities(ser):
+    """Ask the device for its capability descriptor, empty if it has none."""
+    try:
+        ser.write(CAPS_COMMAND)
+        time.sleep(0.1)
+        while ser.in_waiting:
+            line = ser.readline().decode("utf-8", errors="replace").strip()
+            if line.startswith(CAPS_PREFIX):
+                return parse_caps_line(line)
+    except Exception as e:
+        print(f"Error reading capabilities: {e}")
+    # Firmware without a capability command answers with its help text
+    return {}
+
+
+def negotiate_format(ser):
+    """Pick the most efficient output format both sides support, CSV otherwise."""
+    ser.caps = query_capabilities(ser)
+    supported = ser.caps.get("fmt", "csv").split(",")
+    format_name = next(f for f in PREFERRED_FORMATS if f in supported or f == "csv")
+    if format_name != "csv":
+        ser.write(FORMAT_COMMAND + str(FORMAT_CODES[format_name]).encode() + b"\n")
+        time.sleep(0.1)
+        empty_serial_buffer(ser)
+    ser.decoder = DECODERS[format_name]()
+    # One timebase per device for the whole session, frame stamps come with binary frames only
+    ser.sof_aligned = format_name == "bin" and ser.caps.get("sof") == "1"
+    return format_name
+
+
 def create_header(serial_handles):
     """Create a CSV header based on serial numbers."""
     header = ["timestamp"]
@@ -91,10 +418,22 @@ def empty_serial_buffer(ser):
     """Flush and return all lines currently in the serial buffer."""
     result = ""
     while ser.in_waiting:
-        result += "  " + ser.readline().decode("utf-8")
+        result += "  " + ser.readline().decode("utf-8", errors="replace")
     return result
 
 
+def stop_measurement(ser):
+    """Return a measuring device to the command prompt and flush what it sent.
+
+    An autostarted board ignores everything but 'n', 'c', 'u', 'k', '*'
+    and 'x' while it measures, so 'f' and 's' only take effect after this.
+    A device that is not measuring answers with its help text.
+    """
+    ser.write(STOP_COMMAND)
+    time.sleep(0.1)
+    return empty_serial_buffer(ser)
+
+
 def open_serial_ports(adafruit_ports):
     """Open all serial ports and return handles with serial numbers."""
     serial_handles = []
@@ -103,14 +442,19 @@ def open_serial_ports(adafruit_ports):
             ser = MySerial(port.device, BAUD_RATE, timeout=0.1)
             time.sleep(0.1)
             print(f"Message from {port.device}:\n{empty_serial_buffer(ser)}")
+            stop_measurement(ser)
             serial_number = get_serial_number(ser)
             if not serial_number:
                 print(f"Could not read serial number from {port.device}.")
                 ser.close()
                 continue
             ser.setDeviceColorBySerialNumber(serial_number)
+            format_name = negotiate_format(ser)
             serial_handles.append((port, ser, serial_number))
-            print(f"Opened {port.device}, serial number: {serial_number}")
+            print(
+                f"Opened {port.device}, serial number: {serial_number}, "
+                f"firmware: {ser.caps.get('fw', 'unknown')}, format: {format_name}"
+            )
         except Exception as e:
             print(f"Could not open {port.device}: {e}")
     return serial_handles
@@ -124,26 +468,170 @@ def write_csv_header(csv_file_path, header):
     print(f"CSV header: {header}, length: {len(header)}")
 
 
+def supports_trigger(ser):
+    return ser.caps.get("trig") == "1"
+
+
+def start_measurement(ser):
+    """Send 's' and, where supported, pre-arm the broadcast trigger."""
+    ser.write(b"s")
+    if supports_trigger(ser):
+        ser.write(ARM_TRIGGER_COMMAND)
+
+
 def request_sensor_stream(serial_handles):
     """Send 's' to all sensors to start streaming."""
     for port, ser, _ in serial_handles:
-        ser.write(b"s")
+        start_measurement(ser)
         time.sleep(0.1)
         print(f"Message from {ser.device_with_color}:\n{empty_serial_buffer(ser)}")
 
 
 def request_sensor_update(serial_handles):
-    """Send 's' to all sensors to start streaming."""
+    """Request one sample from every sensor as close together as possible.
+
+    Armed devices latch their capture time the moment the one-byte trigger
+    is received, older firmware samples on 'u'. All writes go out back to
+    back before any reply is read.
+    """
     for port, ser, _ in serial_handles:
-        ser.write(b"u")
+        ser.write(TRIGGER_COMMAND if supports_trigger(ser) else b"u")
+    time.sleep(0.1)
+
+
+def rearm_device(ser):
+    """Put a device that rebooted mid-session (e.g. watchdog reset) back into measurement mode."""
+    print(f"{ser.device_with_color}: Device reset detected, re-arming...")
+    ser.rearm_time = time.time()
+    ser.sof_anchor = None  # The device clock restarts, the frame counter does not
+    ser.next_sequence = None  # So does the sample numbering
     time.sleep(0.1)
+    empty_serial_buffer(ser)
+    stop_measurement(ser)  # An autostarted device is measuring already
+    negotiate_format(ser)
+    start_measurement(ser)
+    time.sleep(0.1)
+    print(f"Message from {ser.device_with_color}:\n{empty_serial_buffer(ser)}")
+
+
+def collect_samples(ser, serial_number, events, timebase=None):
+    """Turn decoder events into Samples, reporting text lines and re-arming on reset.
+
+    With a SofTimebase, raw samples of a device that stamps USB frames get
+    their timestamp on the shared timebase instead of the device clock.
+    """
+    samples, raw_samples = [], []
+    for kind, value in events:
+        if ser.in_banner and (kind != "text" or value.startswith(BANNER_END)):
+            # The banner ended without the resume line, anything after it is
+            # setup chatter of the rebooted device
+            ser.in_banner = False
+            rearm_device(ser)
+            break
+        if kind == "sample":
+            samples.append(value)
+        elif kind == "raw":
+            raw_samples.append(value)
+        elif ser.in_banner and value.startswith(RESUME_MARKER):
+            # Same measurement, timestamps continue and buffered samples follow
+            ser.in_banner = False
+            print(f"{ser.device_with_color}: Device resumed after watchdog reset")
+        elif value.startswith(RESET_MARKERS[0]):
+            # Only the rest of the banner tells a resume from a reboot
+            ser.in_banner = True
+        elif value.startswith(RESET_MARKERS):
+            # Help text on its own, the device waits for 's'
+            rearm_device(ser)
+            break
+        elif value.startswith("#"):
+            print(f"{ser.device_with_color}: Comment line: {value}")
+        else:
+            print(f"{ser.device_with_color}: Malformed line: {value}")
+    if raw_samples:
+        timestamps, temperatures, humidities = convert_raw_samples(
+            raw_samples, ser.calibration
+        )
+        if timebase is not None and ser.sof_aligned:
+            # Samples may have been buffered, place each by its age relative to the newest
+            host_time, newest = time.time(), raw_samples[-1].timestamp
+            aligned = [
+                timebase.align(ser, raw, host_time - (newest - raw.timestamp) / 1000.0)
+                for raw in raw_samples
+            ]
+            timestamps = np.round(np.asarray(aligned)).astype(np.int64)
+        # Same two-decimal resolution as the CSV output of the firmware
+        samples.extend(
+            Sample(serial_number, *values)
+            for values in zip(
+                timestamps.tolist(),
+                np.round(temperatures.astype(np.float64), 2).tolist(),
+                np.round(humidities.astype(np.float64), 2).tolist(),
+                [raw.sequence for raw in raw_samples],
+            )
+        )
+    return [sample for sample in samples if check_sequence(ser, sample.sequence)]
+
+
+def check_sequence(ser, sequence):
+    """Report samples the device numbered but never delivered, e.g. lost in a watchdog reset.
+
+    Returns False for a sample that was already logged: a device resumed
+    after a watchdog reset sends again what it sent after the early warning.
+    Only re-arming restarts the numbering.
+    """
+    if sequence is None:
+        return True
+    if ser.next_sequence is not None:
+        if sequence < ser.next_sequence:
+            return False
+        if sequence > ser.next_sequence:
+            lost = sequence - ser.next_sequence
+            ser.lost_samples += lost
+            print(
+                f"{ser.device_with_color}: {lost} samples lost before sequence {sequence} "
+                f"({ser.lost_samples} in total)"
+            )
+    ser.next_sequence = sequence + 1
+    return True
+
+
+def record_outage(ser, serial_number, sample, outage_file_path):
+    """Close an outage on the first sample after re-arming and keep timestamps monotonic."""
+    now = time.time()
+    outage_start = ser.last_sample_time or ser.rearm_time
+    outage_s = now - outage_start
+    # The device clock restarted at zero, continue from where the session left off.
+    # Frame-aligned timestamps never restart and need no offset.
+    if ser.sof_aligned:
+        ser.timestamp_offset = 0
+    else:
+        ser.timestamp_offset = ser.last_timestamp + round(outage_s * 1000) - sample.timestamp
+    ser.rearm_time = None
+    print(f"{ser.device_with_color}: Resumed logging after {outage_s:.1f} s outage")
+    with open(outage_file_path, mode="a", newline="") as file:
+        csv.writer(file).writerow(
+            [
+                serial_number,
+                ser.port,
+                time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(outage_start)),
+                time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(now)),
+                f"{outage_s:.1f}",
+            ]
+        )
 
 
-def log_sensor_data(serial_handles, header, csv_file_path, update_interval=SENSOR_READ_INTERVAL):
+def log_sensor_data(
+    serial_handles,
+    header,
+    csv_file_path,
+    outage_file_path,
+    update_interval=SENSOR_READ_INTERVAL,
+):
     """Continuously log sensor data to CSV."""
     print(f"Starting data logging to {csv_file_path}... Press Ctrl+C to stop.")
 
     last_update_time = time.time()
+    timebase = SofTimebase()
     with open(csv_file_path, mode="a", newline="") as file:
         writer = csv.writer(file)
         while True:
@@ -156,26 +644,24 @@ def log_sensor_data(serial_handles, header, csv_file_path, update_interval=SENSO
             last_update_time = current_time
             request_sensor_update(serial_handles)
             for i, (port, ser, serial_number) in enumerate(serial_handles):
-                row = [None] * len(header)
-                if ser.in_waiting:
-                    try:
-                        line = ser.readline().decode("utf-8").strip()
-                        if not line:
-                            continue
-                        if line.startswith("#"):
-                            print(f"{ser.device_with_color}: Comment line: {line}")
-                            continue
-                        parsed = parse_sensor_line(line)
-                        if not parsed:
-                            print(f"{ser.device_with_color}: Malformed line: {line}")
-                            continue
-                        _, timestamp, temperature, humidity = parsed
-                        row[0] = timestamp
-                        row[i * 2 + 1 : i * 2 + 3] = [temperature, humidity]
-                        writer.writerow(row)
-                        print(f"{ser.device_with_color}: Logged: {row}")
-                    except Exception as e:
-                        print(f"{ser.device_with_color}: Error: {e}")
+                if not ser.in_waiting:
+                    continue
+                try:
+                    events = ser.decoder.feed(ser.read(ser.in_waiting))
+                    samples = collect_samples(ser, serial_number, events, timebase)
+                except Exception as e:
+                    print(f"{ser.device_with_color}: Error: {e}")
+                    continue
+                for sample in samples:
+                    if ser.rearm_time is not None:
+                        record_outage(ser, serial_number, sample, outage_file_path)
+                    row = [None] * len(header)
+                    row[0] = sample.timestamp + ser.timestamp_offset
+                    row[i * 2 + 1 : i * 2 + 3] = [sample.temperature, sample.humidity]
+                    writer.writerow(row)
+                    ser.last_timestamp = row[0]
+                    ser.last_sample_time = time.time()
+                    print(f"{ser.device_with_color}: Logged: {row}")
             file.flush()
             time.sleep(0.05)
 
@@ -194,6 +680,7 @@ def main():
         return
 
     csv_file_path = create_file_name(BASE_CSV_FILE_PATH)
+    outage_file_path = create_outage_file_name(csv_file_path)
     serial_handles = open_serial_ports(adafruit_ports)
     if not serial_handles:
         print("No serial ports could be opened.")
@@ -201,9 +688,10 @@ def main():
 
     header = create_header(serial_handles)
     write_csv_header(csv_file_path, header)
+    write_csv_header(outage_file_path, OUTAGE_HEADER)
     request_sensor_stream(serial_handles)
     try:
-        log_sensor_data(serial_handles, header, csv_file_path)
+        log_sensor_data(serial_handles, header, csv_file_path, outage_file_path)
     except KeyboardInterrupt:
         print("Data logging interrupted.")
     finally:
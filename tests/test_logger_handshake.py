@@ -0,0 +1,180 @@
+"""Logger handshake against a simulated SHT4x Trinkey.
+
+The simulated board follows the command rules of platformio/src/main.cpp:
+while measuring it only answers 'n', 'c', 'u', 'k', '*' and 'x', and a
+free-running board streams a sample every time the host waits.
+"""
+
+from collections import namedtuple
+
+import pytest
+
+import sht4x_trinkey_logger as logger
+
+SERIAL_NUMBER = 0xF030D05B
+SETUP_MSG = "Send 's' to start measurement, 'n' to get serial number, 'c' for capabilities."
+CAPS_LINE = (
+    f"caps: fw=1.2.0 proto=4 fmt=csv,bin board=samd21 sensors=sht4x:0x{SERIAL_NUMBER:X} "
+    "maxrate=625 maxperiod=3600000 buf=64 frame=64 clock=dfll48m ts=ms sof=1 trig=1 "
+    "filters=avg,kalman"
+)
+
+Port = namedtuple("Port", ["device"])
+
+
+class SimulatedBoard(logger.MySerial):
+    """In-memory stand-in for the USB serial port of one board."""
+
+    def __init__(self, measuring=False, binary=False):
+        super().__init__()  # No port, nothing is opened
+        self.measuring = measuring
+        self.binary = binary
+        self.armed = False
+        self.sequence = 0
+        self.timestamp = 1000
+        self.output = bytearray()
+        self.pending = None
+
+    @property
+    def in_waiting(self):
+        return len(self.output)
+
+    def read(self, size=1):
+        data = bytes(self.output[:size])
+        del self.output[:size]
+        return data
+
+    def readline(self):
+        newline = self.output.find(b"\n")
+        return self.read(len(self.output) if newline == -1 else newline + 1)
+
+    def close(self):
+        pass
+
+    def write(self, data):
+        for char in data.decode():
+            if self.pending is not None:
+                if char.isdigit():
+                    self.pending[1] = self.pending[1] * 10 + int(char)
+                    continue
+                self.dispatch(*self.pending)
+                self.pending = None
+            if char in "fk":
+                self.pending = [char, 0]
+            elif char not in "\r\n ":
+                self.dispatch(char, 0)
+        return len(data)
+
+    def println(self, line):
+        self.output += line.encode() + b"\n"
+
+    def dispatch(self, command, argument):
+        if command == "n":
+            self.println(f"0x{SERIAL_NUMBER:X}")
+        elif command == "c":
+            self.println(CAPS_LINE)
+        elif self.measuring:
+            if command in "u*":
+                self.emit_sample()
+            elif command == "k":
+                self.armed = argument != 0
+                self.println("# Trigger armed" if self.armed else "# Trigger disarmed")
+            elif command == "x":
+                self.measuring = False
+                self.armed = False
+                self.println("# Measurement stopped")
+                self.println(SETUP_MSG)
+            # Everything else is ignored in measurement mode
+        elif command == "s":
+            self.measuring = True
+            self.sequence = 0
+            self.println("# sht4SerialNumber, timestamp, temperature (degrees C), humidity (% rH), sequence")
+        elif command == "f":
+            self.binary = argument == 1
+            self.println(f"# Output format: {'binary' if self.binary else 'csv'}")
+        else:
+            self.println(SETUP_MSG)
+
+    def emit_sample(self):
+        t_ticks, rh_ticks = 0x6666, 0x8000
+        if self.binary:
+            payload = logger.RAW_SOF_PAYLOAD.pack(
+                SERIAL_NUMBER, self.timestamp, t_ticks, rh_ticks,
+                self.timestamp % logger.SOF_FRAME_MODULO, 250, 8500, self.sequence,
+            )
+            body = bytes([logger.FRAME_TYPE_RAW_SOF, len(payload)]) + payload
+            self.output += logger.FRAME_SYNC + body + bytes([logger.crc8(body)])
+        else:
+            temperature = -45 + 175 * t_ticks / 65535
+            humidity = -6 + 125 * rh_ticks / 65535
+            self.println(
+                f"0x{SERIAL_NUMBER:X}, {self.timestamp}, {temperature:.2f}, {humidity:.2f}, {self.sequence}"
+            )
+        self.sequence += 1
+        self.timestamp += 100
+
+    def advance(self, seconds):
+        """Host waited: a free-running board sends a sample meanwhile."""
+        if self.measuring and not self.armed:
+            self.emit_sample()
+
+
+@pytest.fixture
+def board(monkeypatch):
+    # Autostarted with a period and binary output saved in flash
+    board = SimulatedBoard(measuring=True, binary=True)
+    board.emit_sample()
+    monkeypatch.setattr(logger, "MySerial", lambda *args, **kwargs: board)
+    monkeypatch.setattr(logger.time, "sleep", board.advance)
+    return board
+
+
+def test_open_stops_autostarted_board(board):
+    serial_handles = logger.open_serial_ports([Port("/dev/ttyACM0")])
+
+    assert len(serial_handles) == 1
+    _, ser, serial_number = serial_handles[0]
+    assert serial_number == f"0x{SERIAL_NUMBER:X}"
+    assert ser.caps["trig"] == "1"
+    assert isinstance(ser.decoder, logger.BinaryDecoder)
+    assert board.binary and not board.measuring
+
+
+def test_stream_after_autostart_handshake(board):
+    serial_handles = logger.open_serial_ports([Port("/dev/ttyACM0")])
+    logger.request_sensor_stream(serial_handles)
+    assert board.measuring and board.armed
+
+    logger.request_sensor_update(serial_handles)
+    _, ser, serial_number = serial_handles[0]
+    events = ser.decoder.feed(ser.read(ser.in_waiting))
+    samples = logger.collect_samples(ser, serial_number, events)
+
+    assert [(sample.serial_number, sample.sequence) for sample in samples] == [
+        (serial_number, 0)
+    ]
+    assert ser.rearm_time is None
+
+
+def test_rearm_autostarted_board_after_reboot(board):
+    serial_handles = logger.open_serial_ports([Port("/dev/ttyACM0")])
+    logger.request_sensor_stream(serial_handles)
+    _, ser, _ = serial_handles[0]
+    # Rebooted by the watchdog without saved state, autostart picks the flash config
+    board.binary, board.armed, board.sequence = False, False, 0
+
+    logger.rearm_device(ser)
+
+    assert board.binary and board.measuring and board.armed
+    assert isinstance(ser.decoder, logger.BinaryDecoder)
+
+
+def test_open_idle_board(monkeypatch):
+    board = SimulatedBoard()
+    monkeypatch.setattr(logger, "MySerial", lambda *args, **kwargs: board)
+    monkeypatch.setattr(logger.time, "sleep", board.advance)
+
+    serial_handles = logger.open_serial_ports([Port("/dev/ttyACM0")])
+
+    assert [serial_number for _, _, serial_number in serial_handles] == [f"0x{SERIAL_NUMBER:X}"]
+    assert board.binary and not board.measuring
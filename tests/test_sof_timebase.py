@@ -0,0 +1,27 @@
+"""Shared USB frame timebase of the logger."""
+
+import sht4x_trinkey_logger as logger
+
+
+def raw_sample(timestamp, sof_frame, sequence):
+    return logger.RawSample("0xF030D05B", timestamp, 0x6666, 0x8000, sof_frame, 500, 8500, sequence)
+
+
+def test_unstamped_samples_keep_the_shared_timebase(monkeypatch):
+    monkeypatch.setattr(logger.time, "time", lambda: 100.0)
+    ser = logger.MySerial()  # No port, nothing is opened
+    ser.sof_aligned = True
+    timebase = logger.SofTimebase()
+
+    # Frame 2040 at device time 5000, then the bus is suspended across a frame wrap
+    first = [raw_sample(5000, 2040, 0), raw_sample(5100, 2140 % 2048, 1)]
+    suspended = [raw_sample(5200, logger.SOF_INVALID, 2), raw_sample(5300, logger.SOF_INVALID, 3)]
+    resumed = [raw_sample(5400, 2440 % 2048, 4)]
+    timestamps = [
+        sample.timestamp
+        for batch in (first, suspended, resumed)
+        for sample in logger.collect_samples(ser, "0xF030D05B", [("raw", raw) for raw in batch], timebase)
+    ]
+
+    assert timestamps == [2040, 2140, 2240, 2340, 2440]
+    assert ser.sof_aligned